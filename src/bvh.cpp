@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include "bvh.hpp"
+
+namespace RT
+{
+    static constexpr unsigned int s_SAHBins = 12;
+
+    static std::uint8_t QuantizeLo(float value, float origin, float scale)
+    {
+        float q = std::clamp(std::floor((value - origin) / scale), 0.0f, 255.0f);
+
+        // Step down until the decoded plane is guaranteed to sit at or below the true bound
+        while (q > 0.0f && origin + q * scale > value) {
+            q -= 1.0f;
+        }
+
+        return static_cast<std::uint8_t>(q);
+    }
+
+    static std::uint8_t QuantizeHi(float value, float origin, float scale)
+    {
+        float q = std::clamp(std::ceil((value - origin) / scale), 0.0f, 255.0f);
+
+        while (q < 255.0f && origin + q * scale < value) {
+            q += 1.0f;
+        }
+
+        return static_cast<std::uint8_t>(q);
+    }
+
+    static int ChooseExponent(float extent)
+    {
+        if (!(extent > 0.0f)) {
+            return QBVH::MinExponent;
+        }
+
+        int exponent = static_cast<int>(std::ceil(std::log2(extent / 255.0f)));
+        exponent = std::clamp(exponent, QBVH::MinExponent, QBVH::MaxExponent);
+
+        // log2 may round down, make sure 255 steps always cover the parent
+        while (exponent < QBVH::MaxExponent && 255.0f * QBVH::ExponentToScale(exponent) < extent) {
+            ++exponent;
+        }
+
+        return exponent;
+    }
+
+    std::vector<std::uint32_t> QBVH::Build(const std::vector<AABB>& bounds)
+    {
+        m_Nodes.clear();
+        m_Bounds = AABB{};
+
+        assert(bounds.size() <= MaxPrimitives);
+        const std::uint32_t count = static_cast<std::uint32_t>(bounds.size());
+
+        m_BuildBounds = bounds;
+        m_BuildCentroids.resize(count);
+        m_BuildOrder.resize(count);
+
+        for (std::uint32_t i = 0; i < count; ++i) {
+            m_BuildCentroids[i] = bounds[i].Center();
+            m_Bounds.Grow(bounds[i]);
+        }
+
+        std::iota(m_BuildOrder.begin(), m_BuildOrder.end(), 0u);
+
+        if (count > 0) {
+            BuildNode(Range{0, count, m_Bounds}, 1);
+        }
+
+        m_Nodes.shrink_to_fit();
+
+        std::vector<std::uint32_t> order = std::move(m_BuildOrder);
+        m_BuildBounds = {};
+        m_BuildCentroids = {};
+        m_BuildOrder = {};
+
+        return order;
+    }
+
+    AABB QBVH::RangeBounds(std::uint32_t begin, std::uint32_t end) const
+    {
+        AABB box;
+
+        for (std::uint32_t i = begin; i < end; ++i) {
+            box.Grow(m_BuildBounds[m_BuildOrder[i]]);
+        }
+
+        return box;
+    }
+
+    std::uint32_t QBVH::Split(const Range& range, bool sah)
+    {
+        AABB centroidBounds;
+
+        for (std::uint32_t i = range.begin; i < range.end; ++i) {
+            centroidBounds.Grow(m_BuildCentroids[m_BuildOrder[i]]);
+        }
+
+        const Vec3 extent = centroidBounds.Extent();
+        int axis = 0;
+
+        if (extent.y > extent[axis]) { axis = 1; }
+        if (extent.z > extent[axis]) { axis = 2; }
+
+        const auto begin = m_BuildOrder.begin() + range.begin;
+        const auto end = m_BuildOrder.begin() + range.end;
+        const std::uint32_t median = range.begin + (range.end - range.begin) / 2;
+
+        if (extent[axis] <= 0.0f) {
+            return median;
+        }
+
+        auto medianSplit = [&]() {
+            std::nth_element(begin, m_BuildOrder.begin() + median, end, [&](std::uint32_t l, std::uint32_t r) {
+                return m_BuildCentroids[l][axis] < m_BuildCentroids[r][axis];
+            });
+
+            return median;
+        };
+
+        if (!sah) {
+            return medianSplit();
+        }
+
+        // Binned SAH along the widest centroid axis
+        struct Bin
+        {
+            AABB bounds;
+            std::uint32_t count = 0;
+        };
+
+        std::array<Bin, s_SAHBins> bins;
+        const float binScale = s_SAHBins / extent[axis];
+        const float binOrigin = centroidBounds.min[axis];
+
+        auto binIndex = [&](std::uint32_t primitive) {
+            const int b = static_cast<int>((m_BuildCentroids[primitive][axis] - binOrigin) * binScale);
+            return static_cast<unsigned int>(std::clamp(b, 0, static_cast<int>(s_SAHBins) - 1));
+        };
+
+        for (std::uint32_t i = range.begin; i < range.end; ++i) {
+            Bin& bin = bins[binIndex(m_BuildOrder[i])];
+            bin.bounds.Grow(m_BuildBounds[m_BuildOrder[i]]);
+            ++bin.count;
+        }
+
+        std::array<float, s_SAHBins - 1> leftCost;
+        AABB leftBounds;
+        std::uint32_t leftCount = 0;
+
+        for (unsigned int b = 0; b < s_SAHBins - 1; ++b) {
+            leftBounds.Grow(bins[b].bounds);
+            leftCount += bins[b].count;
+            leftCost[b] = leftBounds.SurfaceArea() * leftCount;
+        }
+
+        AABB rightBounds;
+        std::uint32_t rightCount = 0;
+        float bestCost = FltInfinity;
+        unsigned int bestBin = 0;
+
+        for (unsigned int b = s_SAHBins - 1; b > 0; --b) {
+            rightBounds.Grow(bins[b].bounds);
+            rightCount += bins[b].count;
+
+            const float cost = leftCost[b - 1] + rightBounds.SurfaceArea() * rightCount;
+
+            if (rightCount < range.end - range.begin && cost < bestCost) {
+                bestCost = cost;
+                bestBin = b;
+            }
+        }
+
+        const auto mid = std::partition(begin, end, [&](std::uint32_t primitive) {
+            return binIndex(primitive) < bestBin;
+        });
+
+        const std::uint32_t split = static_cast<std::uint32_t>(mid - m_BuildOrder.begin());
+
+        // Everything landed on one side, fall back to an object median
+        if (split == range.begin || split == range.end) {
+            return medianSplit();
+        }
+
+        return split;
+    }
+
+    std::uint32_t QBVH::BuildNode(const Range& range, unsigned int depth)
+    {
+        assert(depth <= MaxSAHDepth + MaxMedianDepth);
+
+        // Open up to Width child ranges by repeatedly splitting the most populated one
+        std::array<Range, Width> ranges;
+        unsigned int rangeCount = 1;
+        ranges[0] = range;
+
+        while (rangeCount < Width) {
+            unsigned int largest = Width;
+            std::uint32_t largestSize = MaxLeafSize;
+
+            for (unsigned int r = 0; r < rangeCount; ++r) {
+                const std::uint32_t size = ranges[r].end - ranges[r].begin;
+
+                if (size > largestSize) {
+                    largest = r;
+                    largestSize = size;
+                }
+            }
+
+            if (largest == Width) {
+                break;
+            }
+
+            const Range parent = ranges[largest];
+            const std::uint32_t split = Split(parent, depth < MaxSAHDepth);
+
+            ranges[largest] = Range{parent.begin, split, RangeBounds(parent.begin, split)};
+            ranges[rangeCount++] = Range{split, parent.end, RangeBounds(split, parent.end)};
+        }
+
+        const std::uint32_t nodeIndex = static_cast<std::uint32_t>(m_Nodes.size());
+        m_Nodes.emplace_back();
+
+        Node node{};
+        node.childCount = static_cast<std::uint8_t>(rangeCount);
+
+        for (int axis = 0; axis < 3; ++axis) {
+            const int exponent = ChooseExponent(range.bounds.max[axis] - range.bounds.min[axis]);
+            const float scale = ExponentToScale(exponent);
+
+            node.origin[axis] = range.bounds.min[axis];
+            node.exponent[axis] = static_cast<std::int8_t>(exponent);
+
+            for (unsigned int c = 0; c < rangeCount; ++c) {
+                node.lo[axis][c] = QuantizeLo(ranges[c].bounds.min[axis], node.origin[axis], scale);
+                node.hi[axis][c] = QuantizeHi(ranges[c].bounds.max[axis], node.origin[axis], scale);
+            }
+        }
+
+        for (unsigned int c = 0; c < rangeCount; ++c) {
+            const std::uint32_t size = ranges[c].end - ranges[c].begin;
+
+            if (size <= MaxLeafSize) {
+                node.children[c] = LeafFlag | (size << LeafCountShift) | ranges[c].begin;
+            }
+            else {
+                node.children[c] = BuildNode(ranges[c], depth + 1);
+            }
+        }
+
+        m_Nodes[nodeIndex] = node;
+
+        return nodeIndex;
+    }
+
+    BVH::BVH(HittableList&& list)
+        : m_Objects(std::move(list.Objects()))
+    {
+        std::vector<AABB> bounds;
+        bounds.reserve(m_Objects.size());
+
+        for (auto& object : m_Objects) {
+            bounds.emplace_back(object->BoundingBox());
+        }
+
+        const std::vector<std::uint32_t> order = m_Tree.Build(bounds);
+
+        std::vector<std::unique_ptr<Hittable>> ordered;
+        ordered.reserve(m_Objects.size());
+
+        for (std::uint32_t index : order) {
+            ordered.emplace_back(std::move(m_Objects[index]));
+        }
+
+        m_Objects = std::move(ordered);
+    }
+
+    std::size_t BVH::PrimitiveCount() const
+    {
+        std::size_t count = 0;
+
+        for (const auto& object : m_Objects) {
+            count += object->PrimitiveCount();
+        }
+
+        return count;
+    }
+
+    std::size_t BVH::MemoryUsage() const
+    {
+        std::size_t nested = 0;
+
+        for (const auto& object : m_Objects) {
+            nested += object->AccelerationMemoryUsage();
+        }
+
+        return m_Tree.MemoryUsage() + m_Objects.size() * sizeof(std::unique_ptr<Hittable>) + nested;
+    }
+
+    bool BVH::Hit(const Ray& ray, const Interval& rayInterval, HitInfo* hitInfo) const
+    {
+        HitInfo info;
+
+        return m_Tree.Traverse(ray, rayInterval, [&](std::uint32_t primitive, float tMin, float* tMax) {
+            if (!m_Objects[primitive]->Hit(ray, Interval{tMin, *tMax}, &info)) {
+                return false;
+            }
+
+            *tMax = info.t;
+            *hitInfo = info;
+            return true;
+        });
+    }
+
+    std::uint64_t BVH::HitPacket(const RayPacket& packet, std::uint64_t mask, float tMin, float* tMax, HitInfo* hitInfos) const
+    {
+        // Each primitive sees the sub-packet that reached its leaf, so nested trees keep tracing in packets
+        return m_Tree.TraversePacket(packet, mask, tMin, tMax, [&](std::uint32_t primitive, std::uint64_t leafMask, float leafTMin, float* leafTMax) {
+            return m_Objects[primitive]->HitPacket(packet, leafMask, leafTMin, leafTMax, hitInfos);
+        });
+    }
+}
@@ -0,0 +1,426 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "hittable.hpp"
+#include "hittable_list.hpp"
+
+namespace RT
+{
+    // 4-wide BVH with child bounds quantized to 8 bits relative to the parent node.
+    // Primitives are referenced by their position in the build order returned by Build(),
+    // so callers reorder their primitive storage instead of keeping an index buffer.
+    class QBVH
+    {
+    public:
+        static constexpr unsigned int Width = 4;
+        static constexpr unsigned int MaxLeafSize = 4;
+
+        struct Node
+        {
+            // Child bounds decode as: origin + q * 2^exponent
+            float origin[3];
+            std::int8_t exponent[3];
+            std::uint8_t childCount;
+            std::uint8_t lo[3][Width];
+            std::uint8_t hi[3][Width];
+            std::uint32_t children[Width];
+        };
+
+        // Leaves address primitives with 28 bits
+        static constexpr std::size_t MaxPrimitives = std::size_t{1} << 28;
+
+        QBVH() = default;
+
+        // At most MaxPrimitives bounds, callers reject larger inputs before building
+        std::vector<std::uint32_t> Build(const std::vector<AABB>& bounds);
+
+        const AABB& Bounds() const { return m_Bounds; }
+        std::size_t NodeCount() const { return m_Nodes.size(); }
+        std::size_t MemoryUsage() const { return m_Nodes.size() * sizeof(Node); }
+
+        // Exponents are kept within the normal float range so the scale is built straight from its bits
+        static constexpr int MinExponent = -126;
+        static constexpr int MaxExponent = 127;
+
+        static float ExponentToScale(int exponent)
+        {
+            return std::bit_cast<float>(static_cast<std::uint32_t>(exponent + 127) << 23);
+        }
+
+        // Calls intersect(primitive, tMin, &tMax) for every primitive whose leaf the ray reaches,
+        // nearest first. The callback shrinks tMax when it finds a closer hit.
+        template<typename F>
+        bool Traverse(const Ray& ray, const Interval& rayInterval, F&& intersect) const;
+
+        // Packet version for the rays in mask: the packet descends together, carrying a mask of the rays
+        // still inside. Children are first culled for the packet as a whole with interval arithmetic, then
+        // per ray. Calls intersect(primitive, leafMask, tMin, tMax) once per primitive with the rays that
+        // reached its leaf; it returns the subset it hit and lowers their tMax. Returns the mask of rays that hit.
+        template<typename F>
+        std::uint64_t TraversePacket(const RayPacket& packet, std::uint64_t mask, float tMin, float* tMax, F&& intersect) const;
+
+    private:
+        static constexpr std::uint32_t LeafFlag = 0x80000000u;
+        static constexpr unsigned int LeafCountShift = 28;
+        static constexpr std::uint32_t LeafIndexMask = (1u << LeafCountShift) - 1u;
+        static_assert(LeafIndexMask + std::size_t{1} == MaxPrimitives);
+
+        // Traversal pops one entry and pushes at most Width, so it needs (Width - 1) * depth + 1 stack
+        // entries. Nodes deeper than MaxSAHDepth split at the object median, which at least halves every
+        // child range and bounds the remaining depth for MaxPrimitives.
+        static constexpr unsigned int StackSize = 256;
+        static constexpr unsigned int MaxSAHDepth = 48;
+        static constexpr unsigned int MaxMedianDepth = 27;
+        static_assert((Width - 1) * (MaxSAHDepth + MaxMedianDepth) + 1 <= StackSize);
+
+        struct Range
+        {
+            std::uint32_t begin;
+            std::uint32_t end;
+            AABB bounds;
+        };
+
+        std::uint32_t BuildNode(const Range& range, unsigned int depth);
+        std::uint32_t Split(const Range& range, bool sah);
+        AABB RangeBounds(std::uint32_t begin, std::uint32_t end) const;
+
+    private:
+        std::vector<Node> m_Nodes;
+        AABB m_Bounds;
+
+        // Build scratch, released once Build() returns
+        std::vector<AABB> m_BuildBounds;
+        std::vector<Point3> m_BuildCentroids;
+        std::vector<std::uint32_t> m_BuildOrder;
+    };
+
+    template<typename F>
+    bool QBVH::Traverse(const Ray& ray, const Interval& rayInterval, F&& intersect) const
+    {
+        if (m_Nodes.empty()) {
+            return false;
+        }
+
+        struct Entry
+        {
+            std::uint32_t child;
+            float tNear;
+        };
+
+        // Slightly widen the far slab distance so rounding in the quantized decode stays conservative
+        constexpr float farScale = 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+
+        const Point3& o = ray.origin();
+        const Vec3 invD{1.0f / ray.direction().x, 1.0f / ray.direction().y, 1.0f / ray.direction().z};
+
+        const float tMin = rayInterval.Min();
+        float tMax = rayInterval.Max();
+        bool anyHits = false;
+
+        std::array<Entry, StackSize> stack;
+        unsigned int stackSize = 0;
+        stack[stackSize++] = Entry{0, tMin};
+
+        while (stackSize > 0) {
+            const Entry entry = stack[--stackSize];
+
+            if (entry.tNear > tMax) {
+                continue;
+            }
+
+            if (entry.child & LeafFlag) {
+                const std::uint32_t first = entry.child & LeafIndexMask;
+                const std::uint32_t count = (entry.child & ~LeafFlag) >> LeafCountShift;
+
+                for (std::uint32_t p = first; p < first + count; ++p) {
+                    if (intersect(p, tMin, &tMax)) {
+                        anyHits = true;
+                    }
+                }
+
+                continue;
+            }
+
+            const Node& node = m_Nodes[entry.child];
+
+            float scale[3];
+
+            for (int axis = 0; axis < 3; ++axis) {
+                scale[axis] = ExponentToScale(node.exponent[axis]);
+            }
+
+            Entry hits[Width];
+            unsigned int hitCount = 0;
+
+            for (unsigned int c = 0; c < node.childCount; ++c) {
+                float tNear = tMin;
+                float tFar = tMax;
+
+                for (int axis = 0; axis < 3; ++axis) {
+                    // Decode the planes exactly as the build did before taking slab distances. Folding the
+                    // decode into the distance (origin - o + q * scale) / d loses the relative error bound
+                    // farScale relies on, and rays grazing a box (spheres near their silhouettes, meshes at
+                    // shared vertices) slip past it.
+                    const float lo = node.origin[axis] + node.lo[axis][c] * scale[axis];
+                    const float hi = node.origin[axis] + node.hi[axis][c] * scale[axis];
+
+                    float t0 = (lo - o[axis]) * invD[axis];
+                    float t1 = (hi - o[axis]) * invD[axis];
+
+                    if (invD[axis] < 0.0f) {
+                        std::swap(t0, t1);
+                    }
+
+                    // Written so a NaN slab (0 * inf) leaves the interval untouched
+                    tNear = t0 > tNear ? t0 : tNear;
+                    tFar = t1 * farScale < tFar ? t1 * farScale : tFar;
+                }
+
+                if (tNear <= tFar) {
+                    // Insertion sort, farthest first so the nearest child is popped next
+                    unsigned int k = hitCount++;
+
+                    while (k > 0 && hits[k - 1].tNear < tNear) {
+                        hits[k] = hits[k - 1];
+                        --k;
+                    }
+
+                    hits[k] = Entry{node.children[c], tNear};
+                }
+            }
+
+            for (unsigned int h = 0; h < hitCount; ++h) {
+                stack[stackSize++] = hits[h];
+            }
+        }
+
+        return anyHits;
+    }
+
+    template<typename F>
+    std::uint64_t QBVH::TraversePacket(const RayPacket& packet, std::uint64_t mask, float tMin, float* tMax, F&& intersect) const
+    {
+        mask &= packet.FullMask();
+
+        if (m_Nodes.empty() || mask == 0) {
+            return 0;
+        }
+
+        struct Entry
+        {
+            std::uint32_t child;
+            std::uint64_t mask;
+            float tNear;
+        };
+
+        constexpr float farScale = 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+        constexpr unsigned int maxRays = RayPacket::MaxSize;
+
+        // Rays past the last active one are never looked at
+        const unsigned int count = maxRays - static_cast<unsigned int>(std::countl_zero(mask));
+
+        // Structure of arrays so the per ray slab loop vectorizes
+        float origin[3][maxRays];
+        float invD[3][maxRays];
+
+        // Packet wide intervals of the ray origins and inverse directions
+        Vec3 originMin{FltInfinity};
+        Vec3 originMax{-FltInfinity};
+        Vec3 invDMin{FltInfinity};
+        Vec3 invDMax{-FltInfinity};
+
+        for (unsigned int r = 0; r < count; ++r) {
+            for (int axis = 0; axis < 3; ++axis) {
+                origin[axis][r] = packet.rays[r].origin()[axis];
+                invD[axis][r] = 1.0f / packet.rays[r].direction()[axis];
+
+                if ((mask >> r) & 1u) {
+                    originMin[axis] = std::min(originMin[axis], origin[axis][r]);
+                    originMax[axis] = std::max(originMax[axis], origin[axis][r]);
+                    invDMin[axis] = std::min(invDMin[axis], invD[axis][r]);
+                    invDMax[axis] = std::max(invDMax[axis], invD[axis][r]);
+                }
+            }
+        }
+
+        // Interval culling needs every ray to cross each axis in the same direction
+        bool intervalCulling = true;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            const bool sameSign = (invDMin[axis] > 0.0f) || (invDMax[axis] < 0.0f);
+            intervalCulling = intervalCulling && sameSign && std::isfinite(invDMin[axis]) && std::isfinite(invDMax[axis]);
+        }
+
+        std::uint64_t hits = 0;
+
+        std::array<Entry, StackSize> stack;
+        unsigned int stackSize = 0;
+        stack[stackSize++] = Entry{0, mask, tMin};
+
+        while (stackSize > 0) {
+            Entry entry = stack[--stackSize];
+
+            // Drop the rays that found a hit nearer than the entry since it was pushed
+            for (std::uint64_t active = entry.mask; active != 0; active &= active - 1) {
+                const unsigned int r = static_cast<unsigned int>(std::countr_zero(active));
+
+                if (tMax[r] < entry.tNear) {
+                    entry.mask &= ~(std::uint64_t{1} << r);
+                }
+            }
+
+            if (entry.mask == 0) {
+                continue;
+            }
+
+            if (entry.child & LeafFlag) {
+                const std::uint32_t first = entry.child & LeafIndexMask;
+                const std::uint32_t leafCount = (entry.child & ~LeafFlag) >> LeafCountShift;
+
+                for (std::uint32_t p = first; p < first + leafCount; ++p) {
+                    hits |= intersect(p, entry.mask, tMin, tMax);
+                }
+
+                continue;
+            }
+
+            const Node& node = m_Nodes[entry.child];
+
+            float scale[3];
+
+            for (int axis = 0; axis < 3; ++axis) {
+                scale[axis] = ExponentToScale(node.exponent[axis]);
+            }
+
+            Entry children[Width];
+            unsigned int childCount = 0;
+
+            const bool sparse = static_cast<unsigned int>(std::popcount(entry.mask)) * 4 < count;
+
+            for (unsigned int c = 0; c < node.childCount; ++c) {
+                float lo[3];
+                float hi[3];
+
+                for (int axis = 0; axis < 3; ++axis) {
+                    lo[axis] = node.origin[axis] + node.lo[axis][c] * scale[axis];
+                    hi[axis] = node.origin[axis] + node.hi[axis][c] * scale[axis];
+                }
+
+                if (intervalCulling) {
+                    float tNearBound = tMin;
+                    float tFarBound = FltInfinity;
+
+                    for (int axis = 0; axis < 3; ++axis) {
+                        const bool positive = invDMin[axis] > 0.0f;
+                        const float entryPlane = positive ? lo[axis] : hi[axis];
+                        const float exitPlane = positive ? hi[axis] : lo[axis];
+
+                        // Smallest entry and largest exit distance any ray in the packet can have
+                        const float entry0 = (entryPlane - originMax[axis]) * invDMin[axis];
+                        const float entry1 = (entryPlane - originMax[axis]) * invDMax[axis];
+                        const float entry2 = (entryPlane - originMin[axis]) * invDMin[axis];
+                        const float entry3 = (entryPlane - originMin[axis]) * invDMax[axis];
+                        const float exit0 = (exitPlane - originMax[axis]) * invDMin[axis];
+                        const float exit1 = (exitPlane - originMax[axis]) * invDMax[axis];
+                        const float exit2 = (exitPlane - originMin[axis]) * invDMin[axis];
+                        const float exit3 = (exitPlane - originMin[axis]) * invDMax[axis];
+
+                        tNearBound = std::max(tNearBound, std::min({entry0, entry1, entry2, entry3}));
+                        tFarBound = std::min(tFarBound, std::max({exit0, exit1, exit2, exit3}) * farScale);
+                    }
+
+                    if (tNearBound > tFarBound) {
+                        continue;
+                    }
+                }
+
+                std::uint64_t childMask = 0;
+                float childNear = FltInfinity;
+
+                const auto testRay = [&](unsigned int r) {
+                    float tNear = tMin;
+                    float tFar = tMax[r];
+
+                    for (int axis = 0; axis < 3; ++axis) {
+                        float t0 = (lo[axis] - origin[axis][r]) * invD[axis][r];
+                        float t1 = (hi[axis] - origin[axis][r]) * invD[axis][r];
+
+                        if (invD[axis][r] < 0.0f) {
+                            std::swap(t0, t1);
+                        }
+
+                        tNear = t0 > tNear ? t0 : tNear;
+                        tFar = t1 * farScale < tFar ? t1 * farScale : tFar;
+                    }
+
+                    if (tNear <= tFar && ((entry.mask >> r) & 1u)) {
+                        childMask |= std::uint64_t{1} << r;
+                        childNear = std::min(childNear, tNear);
+                    }
+                };
+
+                // Sweep every lane while the packet is coherent, visit the survivors one by one once it thins out
+                if (sparse) {
+                    for (std::uint64_t active = entry.mask; active != 0; active &= active - 1) {
+                        testRay(static_cast<unsigned int>(std::countr_zero(active)));
+                    }
+                }
+                else {
+                    for (unsigned int r = 0; r < count; ++r) {
+                        testRay(r);
+                    }
+                }
+
+                if (childMask != 0) {
+                    unsigned int k = childCount++;
+
+                    while (k > 0 && children[k - 1].tNear < childNear) {
+                        children[k] = children[k - 1];
+                        --k;
+                    }
+
+                    children[k] = Entry{node.children[c], childMask, childNear};
+                }
+            }
+
+            for (unsigned int c = 0; c < childCount; ++c) {
+                stack[stackSize++] = children[c];
+            }
+        }
+
+        return hits;
+    }
+
+    class BVH : public Hittable
+    {
+    public:
+        explicit BVH(HittableList&& list);
+
+        virtual bool Hit(const Ray& ray, const Interval& rayInterval, HitInfo* hitInfo) const override;
+        virtual std::uint64_t HitPacket(const RayPacket& packet, std::uint64_t mask, float tMin, float* tMax,
+            HitInfo* hitInfos) const override;
+        virtual AABB BoundingBox() const override { return m_Tree.Bounds(); }
+
+        virtual std::size_t PrimitiveCount() const override;
+        virtual std::size_t AccelerationMemoryUsage() const override { return MemoryUsage(); }
+
+        std::size_t Size() const { return m_Objects.size(); }
+        std::size_t NodeCount() const { return m_Tree.NodeCount(); }
+
+        // Nodes plus the primitive pointer array and the trees nested in primitives, excluding the
+        // primitives themselves
+        std::size_t MemoryUsage() const;
+
+    private:
+        std::vector<std::unique_ptr<Hittable>> m_Objects;
+        QBVH m_Tree;
+    };
+}
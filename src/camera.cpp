@@ -1,6 +1,10 @@
-#include <iostream>
 #include <vector>
+#include <string>
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <numbers>
 #include "ppm.hpp"
 #include "material.hpp"
 #include "hittable.hpp"
@@ -8,6 +12,24 @@
 
 namespace RT
 {
+    // Compile time configuration of the per sample code. FixedDepth is the depth limit, or 0 to read it
+    // from the camera; only the book's depth gets a fixed instantiation.
+    template<bool ThinLens, int FixedDepth, BackgroundModel Background>
+    struct RenderKernel
+    {
+        static constexpr bool thinLens = ThinLens;
+        static constexpr int fixedDepth = FixedDepth;
+        static constexpr BackgroundModel background = Background;
+    };
+
+    static constexpr int s_FixedKernelDepth = 50;
+
+    // Ward's recursion: records are computed at up to this many nested levels, and every level but the
+    // first reads and fills the cache at s_SecondaryErrorScale times the error threshold. Paths leaving
+    // the innermost records are traced through.
+    static constexpr int s_IrradianceCacheLevels = 2;
+    static constexpr float s_SecondaryErrorScale = 2.0f;
+
     Camera::Camera(const CameraSettings& settings)
         : m_ImageWidth(settings.imageWidth),
         m_ImageHeight(settings.imageHeight),
@@ -16,7 +38,28 @@ namespace RT
         m_Position(settings.position),
         m_LookAt(settings.lookAt),
         m_VerticalFOV(settings.verticalFOV),
-        m_DefocusAngle(settings.defocusAngle)
+        m_BackgroundColor(settings.backgroundColor),
+        m_Environment(settings.environment),
+        m_OutputTransform(settings.outputTransform),
+        m_DefocusAngle(settings.defocusAngle),
+        m_PacketSize(std::clamp(settings.packetSize, 1u, 8u)),
+        m_TimeBudget(settings.timeBudget),
+        m_RayBudget(settings.rayBudget),
+        m_PassSamples(settings.passSamples),
+        m_SnapshotInterval(settings.snapshotInterval),
+        m_SnapshotPasses(settings.snapshotPasses),
+        m_SnapshotFilename(settings.snapshotFilename),
+        m_PixelFormat(settings.pixelFormat),
+        m_Image(nullptr),
+        m_IrradianceCacheMinSpacing(settings.irradianceCacheMinSpacing),
+        m_IrradianceCacheMaxSpacing(std::max(settings.irradianceCacheMinSpacing, settings.irradianceCacheMaxSpacing)),
+        m_RecordLevel(0),
+        m_Cancelled(false),
+        m_Progress(0.0f),
+        m_Passes(0),
+        m_SamplesRendered(0),
+        m_SnapshotFailures(0),
+        m_RayCount(0)
     {
         const float theta = ToRadians(m_VerticalFOV);
         const float h = std::tan(theta / 2.0f);
@@ -39,91 +82,620 @@ namespace RT
 
         m_Pixel00Location = viewportUpperLeft + (m_PixelDeltaU + m_PixelDeltaV) * 0.5f;
 
+        // Footprint of a pixel per unit of distance from the camera
+        m_PixelAngle = Length(m_PixelDeltaU) / settings.focalDistance;
+
         const float defocusRadius = settings.focalDistance * std::tan(ToRadians(m_DefocusAngle / 2.0f));
         m_DefocusDiskU = u * defocusRadius;
         m_DefocusDiskV = v * defocusRadius;
+
+        if (settings.irradianceCacheError > 0.0f) {
+            m_IrradianceCache = std::make_unique<IrradianceCache>(settings.irradianceCacheError,
+                s_SecondaryErrorScale * settings.irradianceCacheError);
+        }
+
+        const bool thinLens = m_DefocusAngle > 0.0f;
+        const bool fixedDepth = m_MaxDepth == s_FixedKernelDepth;
+
+        BackgroundModel background = settings.background;
+
+        if (background == BackgroundModel::Environment && (!m_Environment || m_Environment->Empty())) {
+            background = BackgroundModel::Sky;
+        }
+
+        if (thinLens) {
+            m_RenderPass = fixedDepth ? SelectRenderPass<true, s_FixedKernelDepth>(background) :
+                SelectRenderPass<true, 0>(background);
+        }
+        else {
+            m_RenderPass = fixedDepth ? SelectRenderPass<false, s_FixedKernelDepth>(background) :
+                SelectRenderPass<false, 0>(background);
+        }
+    }
+
+    template<bool ThinLens, int FixedDepth>
+    Camera::RenderPassFunction Camera::SelectRenderPass(BackgroundModel background)
+    {
+        switch (background) {
+        case BackgroundModel::Solid:
+            return &Camera::RenderPass<RenderKernel<ThinLens, FixedDepth, BackgroundModel::Solid>>;
+
+        case BackgroundModel::Environment:
+            return &Camera::RenderPass<RenderKernel<ThinLens, FixedDepth, BackgroundModel::Environment>>;
+
+        case BackgroundModel::Sky:
+        default:
+            return &Camera::RenderPass<RenderKernel<ThinLens, FixedDepth, BackgroundModel::Sky>>;
+        }
     }
 
     bool Camera::Render(const char* filename, const Hittable& world)
     {
-        std::vector<Color> pixels(m_ImageWidth * m_ImageHeight);
+        Framebuffer image;
+        RenderPasses(world, &image, filename);
+
+        return WriteImage(filename, image, m_OutputTransform);
+    }
+
+    void Camera::Render(const Hittable& world, Framebuffer* image)
+    {
+        RenderPasses(world, image, m_SnapshotFilename.empty() ? nullptr : m_SnapshotFilename.c_str());
+    }
+
+    void Camera::Render(const Hittable& world, std::vector<Color>* pixels)
+    {
+        Framebuffer image;
+        Render(world, &image);
+        image.Resolve(pixels);
+    }
+
+    void Camera::RenderPasses(const Hittable& world, Framebuffer* image, const char* snapshotFilename)
+    {
+        image->Reset(m_ImageWidth, m_ImageHeight, m_PixelFormat);
+        m_Image = image;
+        m_Passes = 0;
+        m_SamplesRendered = 0;
+        m_SnapshotFailures = 0;
+        m_RayCount = 0;
+        m_Progress.store(0.0f, std::memory_order_relaxed);
+        m_RenderTimer = Timer{};
+
+        if (m_IrradianceCache) {
+            m_IrradianceCache->Clear();
+        }
+
+        const bool progressive = m_TimeBudget > 0.0f || m_RayBudget > 0 || m_PassSamples > 0 || m_SnapshotInterval > 0.0f || m_SnapshotPasses > 0;
+        const unsigned int passSamples = (m_PassSamples > 0) ? m_PassSamples : (progressive ? 1 : m_SamplesPerPixel);
+        const double deadline = (m_TimeBudget > 0.0f) ? m_TimeBudget : FltInfinity;
+
+        double lastSnapshot = 0.0;
+
+        while (m_SamplesRendered < m_SamplesPerPixel) {
+            const unsigned int samples = std::min(passSamples, m_SamplesPerPixel - m_SamplesRendered);
+            const bool lastPass = m_SamplesRendered + samples == m_SamplesPerPixel;
+            const bool completed = (this->*m_RenderPass)(world, samples, deadline, lastPass);
+
+            if (!completed) {
+                break;
+            }
+
+            m_SamplesRendered += samples;
+            ++m_Passes;
+
+            const double elapsed = m_RenderTimer.PeekSeconds();
+
+            if (elapsed >= deadline || RayBudgetSpent()) {
+                break;
+            }
+
+            const bool snapshotDue = (m_SnapshotPasses > 0 && m_Passes % m_SnapshotPasses == 0) ||
+                (m_SnapshotInterval > 0.0f && elapsed - lastSnapshot >= m_SnapshotInterval);
+
+            if (snapshotFilename && snapshotDue && m_SamplesRendered < m_SamplesPerPixel) {
+                if (!WriteSnapshot(snapshotFilename)) {
+                    ++m_SnapshotFailures;
+                }
+
+                lastSnapshot = m_RenderTimer.PeekSeconds();
+            }
+        }
+
+        // Tiles left unfinished by the deadline, the ray budget or a cancel
+        image->Finish();
+        m_Image = nullptr;
+    }
+
+    template<typename Kernel>
+    bool Camera::RenderPass(const Hittable& world, unsigned int samples, double deadline, bool lastPass)
+    {
+        constexpr unsigned int tileSize = Framebuffer::TileSize;
+        const unsigned int packetSize = m_PacketSize;
+        const int maxDepth = (Kernel::fixedDepth > 0) ? Kernel::fixedDepth : m_MaxDepth;
+
+        for (unsigned int tileY = 0; tileY < m_Image->TilesY(); ++tileY) {
+            // Stop mid pass rather than overrun the budget, finished rows keep their extra samples
+            if (Cancelled() || m_RenderTimer.PeekSeconds() >= deadline || RayBudgetSpent()) {
+                return false;
+            }
+
+            const unsigned int y0 = tileY * tileSize;
+            const unsigned int tileHeight = std::min(tileSize, m_ImageHeight - y0);
 
-        for (unsigned int j = 0; j < m_ImageHeight; ++j) {
-            std::cout << "\rScanlines remaining: " << m_ImageHeight - j << " " << std::flush;
+            for (unsigned int tileX = 0; tileX < m_Image->TilesX(); ++tileX) {
+                const unsigned int x0 = tileX * tileSize;
+                const unsigned int tileWidth = std::min(tileSize, m_ImageWidth - x0);
 
-            for (unsigned int i = 0; i < m_ImageWidth; ++i) {
-                Color pixelColor{0.0f};
+                Framebuffer::AccumulatorTile& tile = m_Image->Accumulator(tileX, tileY);
 
-                for (unsigned int sample = 0; sample < m_SamplesPerPixel; ++sample) {
-                    const Ray ray = GetRay(i, j);
+                if (packetSize > 1) {
+                    for (unsigned int sample = 0; sample < samples; ++sample) {
+                        for (unsigned int py = 0; py < tileHeight; py += packetSize) {
+                            for (unsigned int px = 0; px < tileWidth; px += packetSize) {
+                                RenderPacket<Kernel>(world, &tile, x0 + px, y0 + py,
+                                    std::min(packetSize, tileWidth - px), std::min(packetSize, tileHeight - py));
+                            }
+                        }
+                    }
+                }
+                else {
+                    for (unsigned int y = 0; y < tileHeight; ++y) {
+                        for (unsigned int x = 0; x < tileWidth; ++x) {
+                            const Point3 pixelCenter = m_Pixel00Location +
+                                (static_cast<float>(x0 + x) * m_PixelDeltaU) + (static_cast<float>(y0 + y) * m_PixelDeltaV);
+
+                            for (unsigned int sample = 0; sample < samples; ++sample) {
+                                const Ray ray = GetRay<Kernel>(pixelCenter);
+                                HitInfo hitInfo;
+
+                                ++m_RayCount;
+                                const bool hit = world.Hit(ray, Interval{0.001f, FltInfinity}, &hitInfo);
+
+                                tile.Add(x, y, TracePath<Kernel>(ray, hit, hitInfo, maxDepth, world));
+                            }
+                        }
+                    }
+                }
 
-                    pixelColor += TraceRay(ray, m_MaxDepth, world);
+                if (lastPass) {
+                    m_Image->FinishTile(tileX, tileY);
                 }
+            }
+
+            ReportProgress(y0 + tileHeight, samples);
+        }
+
+        return true;
+    }
+
+    void Camera::ReportProgress(unsigned int rowsDone, unsigned int passSamples)
+    {
+        RenderProgress progress;
+        progress.passes = m_Passes;
+        progress.samples = m_SamplesRendered;
+        progress.targetSamples = m_SamplesPerPixel;
+        progress.elapsed = m_RenderTimer.PeekSeconds();
+
+        const float rowFraction = static_cast<float>(rowsDone) / m_ImageHeight;
+        const float sampleFraction = (m_SamplesRendered + rowFraction * passSamples) / m_SamplesPerPixel;
+        const float timeFraction = (m_TimeBudget > 0.0f) ? static_cast<float>(progress.elapsed / m_TimeBudget) : 0.0f;
+        const float rayFraction = (m_RayBudget > 0) ? static_cast<float>(static_cast<double>(m_RayCount) / m_RayBudget) : 0.0f;
+
+        progress.fraction = std::min(1.0f, std::max({sampleFraction, timeFraction, rayFraction}));
+        m_Progress.store(progress.fraction, std::memory_order_relaxed);
+
+        if (m_ProgressCallback) {
+            m_ProgressCallback(progress);
+        }
+    }
+
+    template<typename Kernel>
+    void Camera::RenderPacket(const Hittable& world, Framebuffer::AccumulatorTile* tile, unsigned int x0, unsigned int y0,
+        unsigned int width, unsigned int height)
+    {
+        const int maxDepth = (Kernel::fixedDepth > 0) ? Kernel::fixedDepth : m_MaxDepth;
 
-                pixelColor /= static_cast<float>(m_SamplesPerPixel);
+        RayPacket packet;
+        HitInfo hitInfos[RayPacket::MaxSize];
 
-                // Gamma correct
-                pixelColor.x = LinearToGamma(pixelColor.x);
-                pixelColor.y = LinearToGamma(pixelColor.y);
-                pixelColor.z = LinearToGamma(pixelColor.z);
+        // Neighbouring pixel centers are one pixel delta apart, walk them instead of recomputing each
+        Point3 rowCenter = m_Pixel00Location +
+            (static_cast<float>(x0) * m_PixelDeltaU) + (static_cast<float>(y0) * m_PixelDeltaV);
 
-                pixelColor.x = std::clamp(pixelColor.x, 0.0f, 1.0f);
-                pixelColor.y = std::clamp(pixelColor.y, 0.0f, 1.0f);
-                pixelColor.z = std::clamp(pixelColor.z, 0.0f, 1.0f);
+        for (unsigned int y = 0; y < height; ++y) {
+            Point3 pixelCenter = rowCenter;
 
-                pixels[j * m_ImageWidth + i] = pixelColor;
+            for (unsigned int x = 0; x < width; ++x) {
+                packet.rays[packet.size++] = GetRay<Kernel>(pixelCenter);
+                pixelCenter += m_PixelDeltaU;
             }
+
+            rowCenter += m_PixelDeltaV;
         }
 
-        std::cout << "\rWriting PPM file...          " << std::flush;
+        m_RayCount += packet.size;
 
-        if (!WritePPM(filename, m_ImageWidth, m_ImageHeight, reinterpret_cast<const float*>(pixels.data()))) {
-            std::cerr << "Failed to write PPM file: " << filename << std::endl;
-            return false;
+        float tMax[RayPacket::MaxSize];
+        std::fill_n(tMax, packet.size, FltInfinity);
+
+        const std::uint64_t hits = world.HitPacket(packet, packet.FullMask(), 0.001f, tMax, hitInfos);
+
+        // The packet splits up at the first bounce, secondary rays are incoherent
+        for (unsigned int r = 0; r < packet.size; ++r) {
+            const bool hit = (hits >> r) & 1u;
+            const unsigned int x = x0 % Framebuffer::TileSize + r % width;
+            const unsigned int y = y0 % Framebuffer::TileSize + r / width;
+
+            tile->Add(x, y, TracePath<Kernel>(packet.rays[r], hit, hitInfos[r], maxDepth, world));
         }
+    }
 
-        std::cout << "\rDone!                      \n" << std::flush;
+    template<OutputTransform Transform>
+    void Camera::ApplyOutputTransform(float* values, std::size_t count)
+    {
+        // Clamp first, the transforms map [0, 1] onto itself and never see a negative value
+        for (std::size_t v = 0; v < count; ++v) {
+            const float value = std::clamp(values[v], 0.0f, 1.0f);
 
-        return true;
+            if constexpr (Transform == OutputTransform::Gamma22) {
+                values[v] = std::pow(value, 1.0f / 2.2f);
+            }
+            else if constexpr (Transform == OutputTransform::Gamma2) {
+                values[v] = std::sqrt(value);
+            }
+            else {
+                values[v] = value;
+            }
+        }
     }
 
-    float Camera::LinearToGamma(float linear)
+    bool Camera::WriteRows(const char* filename, unsigned int width, unsigned int height,
+        const std::function<void(unsigned int row, Color* pixels)>& source, OutputTransform transform)
     {
-        return std::pow(linear, 1.0f / 2.2f);
+        void (*apply)(float*, std::size_t) = &ApplyOutputTransform<OutputTransform::Gamma22>;
+
+        if (transform == OutputTransform::Gamma2) {
+            apply = &ApplyOutputTransform<OutputTransform::Gamma2>;
+        }
+        else if (transform == OutputTransform::Linear) {
+            apply = &ApplyOutputTransform<OutputTransform::Linear>;
+        }
+
+        std::vector<Color> row(width);
+
+        return WritePPM(filename, width, height, [&](unsigned int j, float* pixels) {
+            source(j, row.data());
+
+            std::copy_n(reinterpret_cast<const float*>(row.data()), static_cast<std::size_t>(width) * 3, pixels);
+            apply(pixels, static_cast<std::size_t>(width) * 3);
+        });
     }
 
-    Color Camera::TraceRay(const Ray& ray, int depth, const Hittable& world)
+    bool Camera::WriteImage(const char* filename, const Framebuffer& image, OutputTransform transform)
     {
-        if (depth <= 0) {
-            return Color{0.0f};
+        return WriteRows(filename, image.Width(), image.Height(), [&image](unsigned int j, Color* pixels) {
+            image.ResolveRow(j, pixels);
+        }, transform);
+    }
+
+    bool Camera::WriteImage(const char* filename, unsigned int width, unsigned int height, const std::vector<Color>& pixels,
+        OutputTransform transform)
+    {
+        return WriteRows(filename, width, height, [&](unsigned int j, Color* row) {
+            std::copy_n(pixels.data() + static_cast<std::size_t>(j) * width, width, row);
+        }, transform);
+    }
+
+    bool Camera::WriteSnapshot(const char* filename) const
+    {
+        // Write beside the output and rename over it, readers never see a half written file
+        const std::string temporary = std::string{filename} + ".tmp";
+
+        if (!WriteImage(temporary.c_str(), *m_Image, m_OutputTransform)) {
+            return false;
         }
 
-        HitInfo hitInfo;
+        std::error_code error;
+        std::filesystem::rename(temporary, filename, error);
+
+        return !error;
+    }
+
+    // Veach's power heuristic with an exponent of 2, the weight of a sample drawn from the first density
+    static float PowerHeuristic(float pdf, float otherPdf)
+    {
+        const float squared = pdf * pdf;
+        return squared / (squared + otherPdf * otherPdf);
+    }
+
+    // Iterative form of the book's recursive ray_color, starting from an already traced ray. Every
+    // bounce multiplies into throughput until the path escapes, is absorbed or runs out of depth.
+    // With an environment map, diffuse vertices also add a light sample, and both ways of reaching
+    // the map are weighted against each other by multiple importance sampling.
+    template<typename Kernel>
+    Color Camera::TracePath(Ray ray, bool hit, HitInfo hitInfo, int depth, const Hittable& world, float diffusePdf)
+    {
+        constexpr bool sampleEnvironment = Kernel::background == BackgroundModel::Environment;
+
+        Color throughput{1.0f};
+        Color radiance{0.0f};
+
+        for (; depth > 0; --depth) {
+            if (!hit) {
+                Color background = BackgroundRadiance<Kernel>(ray);
+
+                if constexpr (sampleEnvironment) {
+                    if (diffusePdf > 0.0f) {
+                        background *= PowerHeuristic(diffusePdf, m_Environment->Pdf(ray.direction()));
+                    }
+                }
+
+                return radiance + Hadamard(throughput, background);
+            }
+
+            Color albedo;
+
+            // The first diffuse vertex of a path reads the cache, and so does that of every path filling a
+            // record, down to s_IrradianceCacheLevels records deep. Each record ray thus ends at its first
+            // diffuse bounce. With an environment map the records leave out what light samples cover, mostly
+            // the sharp shadows of small bright sources, and every vertex reading the cache takes its own
+            // light sample.
+            if (m_IrradianceCache && m_RecordLevel < s_IrradianceCacheLevels && hitInfo.material->DiffuseAlbedo(&albedo)) {
+                const Color irradiance = CachedIrradiance<Kernel>(hitInfo, depth, world);
+                Color reflected = Hadamard(albedo, irradiance) / std::numbers::pi_v<float>;
+
+                if constexpr (sampleEnvironment) {
+                    if (depth > 1) {
+                        reflected += SampleEnvironment(hitInfo, albedo, world);
+                    }
+                }
+
+                return radiance + Hadamard(throughput, reflected);
+            }
+
+            bool diffuse = false;
+
+            if constexpr (sampleEnvironment) {
+                // The light sample stands in for the next bounce escaping, so it needs the depth for one
+                diffuse = depth > 1 && hitInfo.material->DiffuseAlbedo(&albedo);
+
+                if (diffuse) {
+                    radiance += Hadamard(throughput, SampleEnvironment(hitInfo, albedo, world));
+                }
+            }
 
-        if (world.Hit(ray, Interval{0.001f, FltInfinity}, &hitInfo)) {
             Ray scattered;
             Color attenuation;
 
-            if (hitInfo.material->Scatter(ray, hitInfo, &attenuation, &scattered)) {
-                return Hadamard(attenuation, TraceRay(scattered, depth - 1, world));
+            if (!hitInfo.material->Scatter(ray, hitInfo, &attenuation, &scattered)) {
+                return radiance;
+            }
+
+            throughput = Hadamard(throughput, attenuation);
+            ray = scattered;
+
+            if constexpr (sampleEnvironment) {
+                diffusePdf = diffuse ?
+                    std::max(0.0f, Dot(Normalize(ray.direction()), hitInfo.normal)) / std::numbers::pi_v<float> : 0.0f;
             }
 
+            if (depth > 1) {
+                ++m_RayCount;
+                hit = world.Hit(ray, Interval{0.001f, FltInfinity}, &hitInfo);
+            }
+        }
+
+        return radiance;
+    }
+
+    Color Camera::SampleEnvironment(const HitInfo& hitInfo, const Color& albedo, const Hittable& world)
+    {
+        Color environment;
+        float lightPdf;
+        const Vec3 direction = m_Environment->Sample(&environment, &lightPdf);
+        const float cosine = Dot(direction, hitInfo.normal);
+
+        if (lightPdf <= 0.0f || cosine <= 0.0f) {
+            return Color{0.0f};
+        }
+
+        HitInfo occluder;
+        ++m_RayCount;
+
+        if (world.Hit(Ray{hitInfo.point, direction}, Interval{0.001f, FltInfinity}, &occluder)) {
             return Color{0.0f};
         }
 
-        const Vec3 unitRayDirection = Normalize(ray.direction());
-        const float a = 0.5f * (unitRayDirection.y + 1.0f);
-        return Lerp(Vec3{1.0f}, Vec3{0.5f, 0.7f, 1.0f}, a);
+        // Lambertian BRDF albedo / pi, whose own sampling density is cosine / pi
+        const float diffusePdf = cosine / std::numbers::pi_v<float>;
+        const float weight = PowerHeuristic(lightPdf, diffusePdf) * diffusePdf / lightPdf;
+
+        return Hadamard(albedo, environment) * weight;
+    }
+
+    template<typename Kernel>
+    Color Camera::BackgroundRadiance(const Ray& ray) const
+    {
+        if constexpr (Kernel::background == BackgroundModel::Solid) {
+            return m_BackgroundColor;
+        }
+        else if constexpr (Kernel::background == BackgroundModel::Environment) {
+            return m_Environment->Radiance(ray.direction());
+        }
+        else {
+            const Vec3 unitRayDirection = Normalize(ray.direction());
+            const float a = 0.5f * (unitRayDirection.y + 1.0f);
+            return Lerp(Vec3{1.0f}, Vec3{0.5f, 0.7f, 1.0f}, a);
+        }
+    }
+
+    template<typename Kernel>
+    Color Camera::CachedIrradiance(const HitInfo& hitInfo, int depth, const Hittable& world)
+    {
+        Color irradiance;
+
+        // Records are clamped to [min, max] pixels of their own footprint (see the end of this function).
+        // One reaching this point is at most a fraction depthRange of the camera distance closer or
+        // farther, so only the grid levels of that range are visited. Should very wide pixels break the
+        // bound, a missed record only costs a new one.
+        const float pixelFootprint = Length(hitInfo.point - m_Position) * m_PixelAngle;
+        const float depthRange = std::min(0.5f, m_IrradianceCacheMaxSpacing * m_PixelAngle);
+
+        // Radius of a record spanning one pixel
+        const float pixelRadius = pixelFootprint / m_IrradianceCache->ErrorThreshold();
+        const bool secondary = m_RecordLevel > 0;
+        const float errorThreshold = secondary ? s_SecondaryErrorScale * m_IrradianceCache->ErrorThreshold() :
+            m_IrradianceCache->ErrorThreshold();
+
+        if (m_IrradianceCache->Lookup(hitInfo.point, hitInfo.normal, errorThreshold, m_IrradianceCacheMinSpacing * pixelRadius / (1.0f + depthRange),
+            m_IrradianceCacheMaxSpacing * pixelRadius / (1.0f - depthRange), &irradiance)) {
+            return irradiance;
+        }
+
+        // Cosine weighted hemisphere, stratified in sin^2(theta) and phi. Secondary records only reach the
+        // image through another record's average, so they take fewer samples.
+        constexpr int MaxM = 6;
+        constexpr int MaxN = 20;
+        const int M = secondary ? 4 : MaxM;
+        const int N = secondary ? 16 : MaxN;
+        constexpr float pi = std::numbers::pi_v<float>;
+
+        Color radiance[MaxM][MaxN];
+        float distance[MaxM][MaxN];
+        float sinTheta[MaxM][MaxN];
+        float cosTheta[MaxM][MaxN];
+
+        Vec3 tangent, bitangent;
+        OrthonormalBasis(hitInfo.normal, &tangent, &bitangent);
+
+        float inverseDistanceSum = 0.0f;
+        ++m_RecordLevel;
+
+        for (int j = 0; j < M; ++j) {
+            for (int k = 0; k < N; ++k) {
+                const float u = (j + RandomFloat()) / M;
+                const float phi = 2.0f * pi * (k + RandomFloat()) / N;
+
+                sinTheta[j][k] = std::sqrt(u);
+                cosTheta[j][k] = std::sqrt(1.0f - u);
+
+                const Vec3 direction = (std::cos(phi) * sinTheta[j][k]) * tangent +
+                    (std::sin(phi) * sinTheta[j][k]) * bitangent + cosTheta[j][k] * hitInfo.normal;
+
+                const Ray ray{hitInfo.point, direction};
+                HitInfo sampleHit;
+                bool hit = false;
+
+                if (depth > 1) {
+                    ++m_RayCount;
+                    hit = world.Hit(ray, Interval{0.001f, FltInfinity}, &sampleHit);
+                }
+
+                distance[j][k] = hit ? sampleHit.t : FltInfinity;
+                // Cosine distributed like a diffuse bounce, so weighted against light samples the same way
+                const float diffusePdf = (Kernel::background == BackgroundModel::Environment) ? cosTheta[j][k] / pi : 0.0f;
+
+                radiance[j][k] = (depth > 1) ? TracePath<Kernel>(ray, hit, sampleHit, depth - 1, world, diffusePdf) : Color{0.0f};
+
+                inverseDistanceSum += 1.0f / distance[j][k];
+            }
+        }
+
+        --m_RecordLevel;
+
+        IrradianceCache::Record record;
+        record.point = hitInfo.point;
+        record.normal = hitInfo.normal;
+        record.irradiance = Color{0.0f};
+
+        for (int c = 0; c < 3; ++c) {
+            record.rotationalGradient[c] = Vec3{0.0f};
+            record.translationalGradient[c] = Vec3{0.0f};
+        }
+
+        // Gradients after Ward and Heckbert, "Irradiance Gradients" (1992)
+        for (int k = 0; k < N; ++k) {
+            const float phiCenter = 2.0f * pi * (k + 0.5f) / N;
+            const float phiEdge = 2.0f * pi * k / N;
+
+            const Vec3 u = std::cos(phiCenter) * tangent + std::sin(phiCenter) * bitangent;
+            const Vec3 v = -std::sin(phiCenter) * tangent + std::cos(phiCenter) * bitangent;
+            const Vec3 vEdge = -std::sin(phiEdge) * tangent + std::cos(phiEdge) * bitangent;
+
+            const int previousK = (k + N - 1) % N;
+
+            Color rotational{0.0f};
+            Color acrossTheta{0.0f};
+            Color acrossPhi{0.0f};
+
+            for (int j = 0; j < M; ++j) {
+                record.irradiance += radiance[j][k];
+                rotational -= (sinTheta[j][k] / std::max(cosTheta[j][k], 1.0E-3f)) * radiance[j][k];
+
+                const float sinThetaLower = std::sqrt(static_cast<float>(j) / M);
+                const float cosThetaLower = std::sqrt(1.0f - static_cast<float>(j) / M);
+                const float cosThetaUpper = std::sqrt(1.0f - static_cast<float>(j + 1) / M);
+                const float sinThetaCenter = std::sqrt((j + 0.5f) / M);
+
+                if (j > 0) {
+                    const float minDistance = std::min(distance[j][k], distance[j - 1][k]);
+                    acrossTheta += (sinThetaLower * cosThetaLower * cosThetaLower / minDistance) *
+                        (radiance[j][k] - radiance[j - 1][k]);
+                }
+
+                const float minDistance = std::min(distance[j][k], distance[j][previousK]);
+                acrossPhi += ((cosThetaLower - cosThetaUpper) / (sinThetaCenter * minDistance)) *
+                    (radiance[j][k] - radiance[j][previousK]);
+            }
+
+            for (int c = 0; c < 3; ++c) {
+                record.rotationalGradient[c] += (pi / (M * N)) * rotational[c] * v;
+                record.translationalGradient[c] += ((2.0f * pi / N) * acrossTheta[c]) * u + acrossPhi[c] * vEdge;
+            }
+        }
+
+        record.irradiance *= pi / (M * N);
+
+        // Harmonic mean distance, shrunk where the gradient says irradiance changes faster than that
+        record.radius = (M * N) / inverseDistanceSum;
+
+        for (int c = 0; c < 3; ++c) {
+            const float gradient = Length(record.translationalGradient[c]);
+
+            if (gradient > 0.0f) {
+                record.radius = std::min(record.radius, record.irradiance[c] / gradient);
+            }
+        }
+
+        // Clamped in pixels, so records are neither denser than the image can show nor coarser than it needs
+        record.minRadius = m_IrradianceCacheMinSpacing * pixelRadius;
+        record.radius = std::clamp(record.radius, record.minRadius, m_IrradianceCacheMaxSpacing * pixelRadius);
+
+        // Raised to the minimum, the radius no longer bounds the gradient. Limited to what the irradiance
+        // itself is over the radius, a corner's steep falloff is not extrapolated onto the next wall.
+        for (int c = 0; c < 3; ++c) {
+            const float gradient = Length(record.translationalGradient[c]);
+
+            if (gradient * record.radius > record.irradiance[c]) {
+                record.translationalGradient[c] *= record.irradiance[c] / (gradient * record.radius);
+            }
+        }
+
+        m_IrradianceCache->Insert(record);
+
+        return record.irradiance;
     }
 
-    Ray Camera::GetRay(unsigned int i, unsigned int j)
+    template<typename Kernel>
+    Ray Camera::GetRay(const Point3& pixelCenter)
     {
-        const Vec3 pixelCenter = m_Pixel00Location +
-            (static_cast<float>(i) * m_PixelDeltaU) + (static_cast<float>(j) * m_PixelDeltaV);
-        
         const Vec3 pixelSample = pixelCenter + PixelSampleSquare();
 
-        const Vec3 rayOrigin = (m_DefocusAngle <= 0.0f) ? m_Position : DefocusDiskSample();
+        Vec3 rayOrigin = m_Position;
+
+        if constexpr (Kernel::thinLens) {
+            rayOrigin = DefocusDiskSample();
+        }
+
         const Vec3 rayDirection = pixelSample - rayOrigin;
 
         return Ray{rayOrigin, rayDirection};
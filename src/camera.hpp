@@ -1,9 +1,36 @@
 #pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "timer.hpp"
+#include "environment_map.hpp"
+#include "framebuffer.hpp"
+#include "irradiance_cache.hpp"
 #include "hittable.hpp"
 #include "rtmath.hpp"
 
 namespace RT
 {
+    // Radiance of rays that leave the scene: the book's sky gradient, a single color or an environment map
+    enum class BackgroundModel
+    {
+        Sky,
+        Solid,
+        Environment
+    };
+
+    // Applied to clamped linear values when an image is written
+    enum class OutputTransform
+    {
+        Gamma22,
+        Gamma2,
+        Linear
+    };
+
     struct CameraSettings
     {
         unsigned int imageWidth;
@@ -17,19 +44,142 @@ namespace RT
 
         float defocusAngle;
         float focalDistance;
+
+        BackgroundModel background = BackgroundModel::Sky;
+        Color backgroundColor{0.0f};
+
+        // Lights the scene for BackgroundModel::Environment, which falls back to Sky without one.
+        // Diffuse surfaces sample it directly as well as by bouncing into it.
+        std::shared_ptr<const EnvironmentMap> environment;
+        OutputTransform outputTransform = OutputTransform::Gamma22;
+
+        // Finished pixels are packed to this format. fp16 or RGB9E5 are indistinguishable in 8-bit output
+        // and save memory, but also quantize the linear radiance Render resolves into memory.
+        PixelFormat pixelFormat = PixelFormat::Float32;
+
+        // Progressive rendering: passes of passSamples samples over the whole image until samples is
+        // reached, timeBudget (seconds) runs out or rayBudget rays were traced. Zero disables a limit.
+        // Unlike time, the ray budget ends a fixed seed render at the same point on every machine.
+        float timeBudget = 0.0f;
+        std::uint64_t rayBudget = 0;
+        unsigned int passSamples = 0;
+
+        // Primary rays are traced in packetSize x packetSize pixel bundles, 1 traces them one by one
+        unsigned int packetSize = 8;
+
+        // Irradiance caching for Lambertian surfaces, irradianceCacheError is Ward's error threshold a
+        // (0 disables). The distance over which a record is reused is clamped to this range in pixels,
+        // measured by the pixel footprint at the record.
+        float irradianceCacheError = 0.0f;
+        float irradianceCacheMinSpacing = 2.0f;
+        float irradianceCacheMaxSpacing = 64.0f;
+
+        // Rewrite the output file every snapshotInterval seconds and/or snapshotPasses passes.
+        // In-memory renders write snapshots to snapshotFilename, if one is given.
+        float snapshotInterval = 0.0f;
+        unsigned int snapshotPasses = 0;
+        std::string snapshotFilename;
+    };
+
+    struct RenderProgress
+    {
+        unsigned int passes;
+        unsigned int samples;
+        unsigned int targetSamples;
+        double elapsed;
+
+        // 0 to 1, of the sample target, the time budget or the ray budget, whichever will end the render first
+        float fraction;
     };
 
     class Camera
     {
     public:
+        using ProgressCallback = std::function<void(const RenderProgress&)>;
+
         Camera(const CameraSettings& settings);
+
+        // Renders and writes the gamma corrected result to a PPM file
         bool Render(const char* filename, const Hittable& world);
-    
+
+        // Renders into memory, the framebuffer is reset to the camera's size and pixel format
+        void Render(const Hittable& world, Framebuffer* image);
+
+        // Renders and resolves linear radiance, row major, quantized to pixelFormat unless it is Float32
+        void Render(const Hittable& world, std::vector<Color>* pixels);
+
+        // Called on the rendering thread after every row of tiles
+        void SetProgressCallback(ProgressCallback callback) { m_ProgressCallback = std::move(callback); }
+
+        // Both are safe to call from any thread while rendering. A cancelled render stops at the
+        // next row of tiles and resolves what it has, the camera stays cancelled afterwards.
+        void Cancel() { m_Cancelled.store(true, std::memory_order_relaxed); }
+        bool Cancelled() const { return m_Cancelled.load(std::memory_order_relaxed); }
+        float Progress() const { return m_Progress.load(std::memory_order_relaxed); }
+
+        unsigned int ImageWidth() const { return m_ImageWidth; }
+        unsigned int ImageHeight() const { return m_ImageHeight; }
+
+        // Rays cast against the world by the last Render call, primary and secondary
+        std::uint64_t RayCount() const { return m_RayCount; }
+
+        // Samples per pixel actually reached by the last Render call, below the target if the time budget ran out
+        unsigned int SamplesRendered() const { return m_SamplesRendered; }
+
+        std::size_t IrradianceRecords() const { return m_IrradianceCache ? m_IrradianceCache->Size() : 0; }
+
+        // Snapshots of the last Render call that could not be written
+        unsigned int SnapshotFailures() const { return m_SnapshotFailures; }
+
+        // Clamps linear pixels and writes them through the output transform into a PPM file, one row at a time
+        static bool WriteImage(const char* filename, const Framebuffer& image, OutputTransform transform = OutputTransform::Gamma22);
+        static bool WriteImage(const char* filename, unsigned int width, unsigned int height, const std::vector<Color>& pixels,
+            OutputTransform transform = OutputTransform::Gamma22);
+
     private:
-        Color TraceRay(const Ray& ray, int depth, const Hittable& world);
-        Ray GetRay(unsigned int i, unsigned int j);
+        // The per sample code is compiled once per Kernel (see RenderKernel in camera.cpp), with the lens,
+        // depth limit and background fixed, and the matching RenderPass instantiation is picked at construction.
+        using RenderPassFunction = bool (Camera::*)(const Hittable&, unsigned int, double, bool);
+
+        template<bool ThinLens, int FixedDepth>
+        static RenderPassFunction SelectRenderPass(BackgroundModel background);
+
+        void RenderPasses(const Hittable& world, Framebuffer* image, const char* snapshotFilename);
+        void ReportProgress(unsigned int rowsDone, unsigned int passSamples);
+        bool RayBudgetSpent() const { return m_RayBudget > 0 && m_RayCount >= m_RayBudget; }
+        bool WriteSnapshot(const char* filename) const;
+
+        // The last pass finishes every tile it completes
+        template<typename Kernel>
+        bool RenderPass(const Hittable& world, unsigned int samples, double deadline, bool lastPass);
+
+        // x0 and y0 are pixel coordinates, the packet lies within tile
+        template<typename Kernel>
+        void RenderPacket(const Hittable& world, Framebuffer::AccumulatorTile* tile, unsigned int x0, unsigned int y0,
+            unsigned int width, unsigned int height);
+
+        template<OutputTransform Transform>
+        static void ApplyOutputTransform(float* values, std::size_t count);
+
+        static bool WriteRows(const char* filename, unsigned int width, unsigned int height,
+            const std::function<void(unsigned int row, Color* pixels)>& source, OutputTransform transform);
+
+        // diffusePdf is the cosine density of the diffuse bounce that produced ray, when its vertex also
+        // sampled the environment map, and 0 otherwise
+        template<typename Kernel>
+        Color TracePath(Ray ray, bool hit, HitInfo hitInfo, int depth, const Hittable& world, float diffusePdf = 0.0f);
 
-        float LinearToGamma(float linear);
+        template<typename Kernel>
+        Color CachedIrradiance(const HitInfo& hitInfo, int depth, const Hittable& world);
+
+        template<typename Kernel>
+        Color BackgroundRadiance(const Ray& ray) const;
+
+        // Next event estimate of the environment light reflected by a diffuse surface
+        Color SampleEnvironment(const HitInfo& hitInfo, const Color& albedo, const Hittable& world);
+
+        template<typename Kernel>
+        Ray GetRay(const Point3& pixelCenter);
 
         const Vec3 PixelSampleSquare();
         const Vec3 DefocusDiskSample();
@@ -44,12 +194,49 @@ namespace RT
         Point3 m_LookAt;
         float m_VerticalFOV;
 
+        Color m_BackgroundColor;
+        std::shared_ptr<const EnvironmentMap> m_Environment;
+        OutputTransform m_OutputTransform;
+        RenderPassFunction m_RenderPass;
+
         Point3 m_Pixel00Location;
         Vec3 m_PixelDeltaU;
         Vec3 m_PixelDeltaV;
+        float m_PixelAngle;
 
         float m_DefocusAngle;
         Vec3 m_DefocusDiskU;
         Vec3 m_DefocusDiskV;
+
+        unsigned int m_PacketSize;
+
+        float m_TimeBudget;
+        std::uint64_t m_RayBudget;
+        unsigned int m_PassSamples;
+        float m_SnapshotInterval;
+        unsigned int m_SnapshotPasses;
+        std::string m_SnapshotFilename;
+
+        PixelFormat m_PixelFormat;
+
+        // Target of the Render call in progress
+        Framebuffer* m_Image;
+
+        std::unique_ptr<IrradianceCache> m_IrradianceCache;
+        float m_IrradianceCacheMinSpacing;
+        float m_IrradianceCacheMaxSpacing;
+
+        // Number of records being computed, each nested in the one before
+        int m_RecordLevel;
+
+        ProgressCallback m_ProgressCallback;
+        std::atomic<bool> m_Cancelled;
+        std::atomic<float> m_Progress;
+
+        Timer m_RenderTimer;
+        unsigned int m_Passes;
+        unsigned int m_SamplesRendered;
+        unsigned int m_SnapshotFailures;
+        std::uint64_t m_RayCount;
     };
 }
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <utility>
+#include "pfm.hpp"
+#include "environment_map.hpp"
+
+namespace RT
+{
+    static constexpr float s_Pi = std::numbers::pi_v<float>;
+
+    static double Luminance(const Color& color)
+    {
+        const double luminance = 0.2126 * color.x + 0.7152 * color.y + 0.0722 * color.z;
+
+        // Negated compare so NaN lands on zero
+        return !(luminance > 0.0) ? 0.0 : luminance;
+    }
+
+    bool EnvironmentMap::Load(const char* filename)
+    {
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::vector<float> values;
+
+        if (!ReadPFM(filename, &width, &height, &values)) {
+            return false;
+        }
+
+        std::vector<Color> radiance(static_cast<std::size_t>(width) * height);
+
+        for (std::size_t p = 0; p < radiance.size(); ++p) {
+            radiance[p] = Color{values[p * 3 + 0], values[p * 3 + 1], values[p * 3 + 2]};
+        }
+
+        Reset(width, height, std::move(radiance));
+        return true;
+    }
+
+    void EnvironmentMap::Reset(unsigned int width, unsigned int height, std::vector<Color> radiance)
+    {
+        m_Width = width;
+        m_Height = height;
+        m_Radiance = std::move(radiance);
+        m_AliasTable.clear();
+
+        const std::size_t count = m_Radiance.size();
+
+        // Pixels shrink towards the poles, weigh them by the sine at their center
+        std::vector<double> weights(count);
+        double total = 0.0;
+
+        for (unsigned int y = 0; y < m_Height; ++y) {
+            const double sinTheta = std::sin(std::numbers::pi * (y + 0.5) / m_Height);
+
+            for (unsigned int x = 0; x < m_Width; ++x) {
+                const std::size_t p = static_cast<std::size_t>(y) * m_Width + x;
+                weights[p] = Luminance(m_Radiance[p]) * sinTheta;
+                total += weights[p];
+            }
+        }
+
+        if (!(total > 0.0)) {
+            return;
+        }
+
+        // Vose's alias method: pair every pixel below the mean weight with one above it, which
+        // tops the small one up to exactly the mean
+        m_AliasTable.resize(count);
+
+        std::vector<double> scaled(count);
+        std::vector<std::uint32_t> small;
+        std::vector<std::uint32_t> large;
+
+        for (std::size_t p = 0; p < count; ++p) {
+            m_AliasTable[p].probability = static_cast<float>(weights[p] / total);
+            scaled[p] = weights[p] * count / total;
+            (scaled[p] < 1.0 ? small : large).emplace_back(static_cast<std::uint32_t>(p));
+        }
+
+        while (!small.empty() && !large.empty()) {
+            const std::uint32_t less = small.back();
+            const std::uint32_t more = large.back();
+            small.pop_back();
+            large.pop_back();
+
+            m_AliasTable[less].threshold = static_cast<float>(scaled[less]);
+            m_AliasTable[less].alias = more;
+
+            scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+            (scaled[more] < 1.0 ? small : large).emplace_back(more);
+        }
+
+        // Whatever is left is at the mean up to rounding
+        for (const std::vector<std::uint32_t>* rest : {&small, &large}) {
+            for (std::uint32_t p : *rest) {
+                m_AliasTable[p].threshold = 1.0f;
+                m_AliasTable[p].alias = p;
+            }
+        }
+    }
+
+    std::size_t EnvironmentMap::PixelIndex(const Vec3& direction, float* sinTheta) const
+    {
+        const Vec3 unitDirection = Normalize(direction);
+        const float cosTheta = std::clamp(unitDirection.y, -1.0f, 1.0f);
+        const float phi = std::atan2(unitDirection.z, unitDirection.x);
+
+        *sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+
+        const float u = (phi + s_Pi) / (2.0f * s_Pi);
+        const float v = std::acos(cosTheta) / s_Pi;
+
+        const unsigned int x = std::min(static_cast<unsigned int>(u * m_Width), m_Width - 1);
+        const unsigned int y = std::min(static_cast<unsigned int>(v * m_Height), m_Height - 1);
+
+        return static_cast<std::size_t>(y) * m_Width + x;
+    }
+
+    float EnvironmentMap::SolidAnglePdf(float probability, float sinTheta) const
+    {
+        // A pixel covers (2 pi / width) x (pi / height) of (phi, theta), and dw = sin(theta) dtheta dphi
+        if (sinTheta <= 0.0f) {
+            return 0.0f;
+        }
+
+        return probability * static_cast<float>(m_Width) * static_cast<float>(m_Height) / (2.0f * s_Pi * s_Pi * sinTheta);
+    }
+
+    Color EnvironmentMap::Radiance(const Vec3& direction) const
+    {
+        if (m_Radiance.empty()) {
+            return Color{0.0f};
+        }
+
+        float sinTheta;
+        return m_Radiance[PixelIndex(direction, &sinTheta)];
+    }
+
+    Vec3 EnvironmentMap::Sample(Color* radiance, float* pdf) const
+    {
+        if (m_AliasTable.empty()) {
+            *radiance = Color{0.0f};
+            *pdf = 0.0f;
+            return Vec3{0.0f, 1.0f, 0.0f};
+        }
+
+        std::uint32_t p = RandomIndex(static_cast<std::uint32_t>(m_AliasTable.size()));
+
+        if (RandomFloat() >= m_AliasTable[p].threshold) {
+            p = m_AliasTable[p].alias;
+        }
+
+        // Uniform in (phi, theta) within the pixel
+        const unsigned int x = p % m_Width;
+        const unsigned int y = p / m_Width;
+        const float phi = 2.0f * s_Pi * (x + RandomFloat()) / m_Width - s_Pi;
+        const float theta = s_Pi * (y + RandomFloat()) / m_Height;
+        const float sinTheta = std::sin(theta);
+
+        *radiance = m_Radiance[p];
+        *pdf = SolidAnglePdf(m_AliasTable[p].probability, sinTheta);
+
+        return Vec3{sinTheta * std::cos(phi), std::cos(theta), sinTheta * std::sin(phi)};
+    }
+
+    float EnvironmentMap::Pdf(const Vec3& direction) const
+    {
+        if (m_AliasTable.empty()) {
+            return 0.0f;
+        }
+
+        float sinTheta;
+        const std::size_t p = PixelIndex(direction, &sinTheta);
+
+        return SolidAnglePdf(m_AliasTable[p].probability, sinTheta);
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "rtmath.hpp"
+
+namespace RT
+{
+    // Latitude-longitude radiance map lighting everything outside the scene. Row 0 is straight up (+y),
+    // columns run with the azimuth atan2(z, x) from -pi at the left edge. Directions are drawn in
+    // proportion to each pixel's luminance times its solid angle from an alias table, in constant time.
+    class EnvironmentMap
+    {
+    public:
+        EnvironmentMap() = default;
+
+        // Reads an RGB or greyscale PFM
+        bool Load(const char* filename);
+
+        // radiance is top to bottom, row major
+        void Reset(unsigned int width, unsigned int height, std::vector<Color> radiance);
+
+        unsigned int Width() const { return m_Width; }
+        unsigned int Height() const { return m_Height; }
+        bool Empty() const { return m_Radiance.empty(); }
+
+        // Nearest pixel, direction need not be normalized
+        Color Radiance(const Vec3& direction) const;
+
+        // Returns a unit direction with its radiance and its density per unit solid angle. A pdf of 0
+        // means the map is black and nothing was sampled.
+        Vec3 Sample(Color* radiance, float* pdf) const;
+
+        // Density of Sample picking direction
+        float Pdf(const Vec3& direction) const;
+
+        std::size_t MemoryUsage() const
+        {
+            return m_Radiance.size() * sizeof(Color) + m_AliasTable.size() * sizeof(AliasEntry);
+        }
+
+    private:
+        // Pixel i is kept with probability threshold, otherwise its alias is taken instead
+        struct AliasEntry
+        {
+            float threshold;
+            std::uint32_t alias;
+            float probability;
+        };
+
+        std::size_t PixelIndex(const Vec3& direction, float* sinTheta) const;
+
+        // Converts the probability of a pixel to a density over the sphere, sinTheta of the direction within it
+        float SolidAnglePdf(float probability, float sinTheta) const;
+
+    private:
+        unsigned int m_Width = 0;
+        unsigned int m_Height = 0;
+
+        std::vector<Color> m_Radiance;
+        std::vector<AliasEntry> m_AliasTable;
+    };
+}
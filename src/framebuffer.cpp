@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include "framebuffer.hpp"
+
+namespace RT
+{
+    // Round to nearest even, after Fabian Giesen's float_to_half_fast3_rtne. Finite values saturate
+    // at the largest half instead of turning into infinity.
+    static std::uint16_t FloatToHalf(float value)
+    {
+        constexpr std::uint32_t f32Infinity = 255u << 23;
+        constexpr std::uint32_t f16Max = (127u + 16u) << 23;
+        constexpr std::uint32_t denormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+        std::uint32_t bits = std::bit_cast<std::uint32_t>(std::min(value, 65504.0f));
+        const std::uint32_t sign = bits & 0x80000000u;
+        bits ^= sign;
+
+        std::uint32_t half;
+
+        if (bits >= f16Max) {
+            half = (bits > f32Infinity) ? 0x7E00u : 0x7C00u;
+        }
+        else if (bits < (113u << 23)) {
+            // Denormal or zero, let the float adder do the rounding
+            const float denormal = std::bit_cast<float>(bits) + std::bit_cast<float>(denormMagic);
+            half = std::bit_cast<std::uint32_t>(denormal) - denormMagic;
+        }
+        else {
+            const std::uint32_t mantissaOdd = (bits >> 13) & 1u;
+            bits += ((15u - 127u) << 23) + 0xFFFu;
+            bits += mantissaOdd;
+            half = bits >> 13;
+        }
+
+        return static_cast<std::uint16_t>(half | (sign >> 16));
+    }
+
+    static float HalfToFloat(std::uint16_t half)
+    {
+        constexpr std::uint32_t shiftedExponent = 0x7C00u << 13;
+
+        std::uint32_t bits = (half & 0x7FFFu) << 13;
+        const std::uint32_t exponent = bits & shiftedExponent;
+        bits += (127u - 15u) << 23;
+
+        if (exponent == shiftedExponent) {
+            bits += (128u - 16u) << 23;
+        }
+        else if (exponent == 0) {
+            bits += 1u << 23;
+            bits = std::bit_cast<std::uint32_t>(std::bit_cast<float>(bits) - std::bit_cast<float>(113u << 23));
+        }
+
+        return std::bit_cast<float>(bits | (static_cast<std::uint32_t>(half & 0x8000u) << 16));
+    }
+
+    // Three 9-bit mantissas sharing a 5-bit exponent, as in EXT_texture_shared_exponent
+    static constexpr int s_RGB9E5MantissaBits = 9;
+    static constexpr int s_RGB9E5ExponentBias = 15;
+    static constexpr float s_RGB9E5Max = 65408.0f;
+
+    static std::uint32_t PackRGB9E5(const Color& color)
+    {
+        float rgb[3];
+
+        for (int c = 0; c < 3; ++c) {
+            // Negated compare so NaN lands on zero
+            rgb[c] = !(color[c] > 0.0f) ? 0.0f : std::min(color[c], s_RGB9E5Max);
+        }
+
+        const float maxChannel = std::max({rgb[0], rgb[1], rgb[2]});
+
+        int exponent = -s_RGB9E5ExponentBias - 1;
+
+        if (maxChannel > 0.0f) {
+            int frexpExponent = 0;
+            std::frexp(maxChannel, &frexpExponent);
+            exponent = std::max(exponent, frexpExponent - 1);
+        }
+
+        int sharedExponent = exponent + 1 + s_RGB9E5ExponentBias;
+        float scale = std::ldexp(1.0f, s_RGB9E5MantissaBits + s_RGB9E5ExponentBias - sharedExponent);
+
+        // Rounding may carry the largest mantissa over to 512
+        if (std::floor(maxChannel * scale + 0.5f) >= static_cast<float>(1 << s_RGB9E5MantissaBits)) {
+            ++sharedExponent;
+            scale *= 0.5f;
+        }
+
+        std::uint32_t packed = static_cast<std::uint32_t>(sharedExponent) << 27;
+
+        for (int c = 0; c < 3; ++c) {
+            const std::uint32_t mantissa = static_cast<std::uint32_t>(std::floor(rgb[c] * scale + 0.5f));
+            packed |= std::min(mantissa, 511u) << (s_RGB9E5MantissaBits * c);
+        }
+
+        return packed;
+    }
+
+    static Color UnpackRGB9E5(std::uint32_t packed)
+    {
+        const int sharedExponent = static_cast<int>(packed >> 27);
+        const float scale = std::ldexp(1.0f, sharedExponent - s_RGB9E5ExponentBias - s_RGB9E5MantissaBits);
+
+        return Color{
+            static_cast<float>(packed & 0x1FFu) * scale,
+            static_cast<float>((packed >> 9) & 0x1FFu) * scale,
+            static_cast<float>((packed >> 18) & 0x1FFu) * scale};
+    }
+
+    void Framebuffer::Reset(unsigned int width, unsigned int height, PixelFormat format)
+    {
+        m_Width = width;
+        m_Height = height;
+        m_TilesX = (width + TileSize - 1) / TileSize;
+        m_TilesY = (height + TileSize - 1) / TileSize;
+        m_Format = format;
+
+        const std::size_t tileCount = static_cast<std::size_t>(m_TilesX) * m_TilesY;
+
+        m_Accumulators.clear();
+        m_Accumulators.resize(tileCount);
+        m_Finished.assign(tileCount, 0);
+        m_Packed.clear();
+        m_Packed.resize(m_TilesY);
+    }
+
+    unsigned int Framebuffer::PackedBytes() const
+    {
+        switch (m_Format) {
+        case PixelFormat::Half:
+            return 3 * sizeof(std::uint16_t);
+
+        case PixelFormat::RGB9E5:
+            return sizeof(std::uint32_t);
+
+        case PixelFormat::Float32:
+        default:
+            return 0;
+        }
+    }
+
+    Framebuffer::AccumulatorTile& Framebuffer::Accumulator(unsigned int tileX, unsigned int tileY)
+    {
+        std::unique_ptr<AccumulatorTile>& tile = m_Accumulators[TileIndex(tileX, tileY)];
+
+        if (!tile) {
+            tile = std::make_unique<AccumulatorTile>();
+        }
+
+        return *tile;
+    }
+
+    void Framebuffer::FinishTile(unsigned int tileX, unsigned int tileY)
+    {
+        const std::size_t tile = TileIndex(tileX, tileY);
+        const unsigned int bytes = PackedBytes();
+
+        if (m_Finished[tile]) {
+            return;
+        }
+
+        m_Finished[tile] = 1;
+
+        if (bytes == 0 || !m_Accumulators[tile]) {
+            return;
+        }
+
+        std::vector<std::uint8_t>& packedRow = m_Packed[tileY];
+
+        if (packedRow.empty()) {
+            packedRow.assign(static_cast<std::size_t>(m_TilesX) * TilePixels * bytes, 0);
+        }
+
+        const AccumulatorTile& accumulator = *m_Accumulators[tile];
+        std::uint8_t* packed = packedRow.data() + static_cast<std::size_t>(tileX) * TilePixels * bytes;
+
+        // Pixels are byte packed without padding, so they go through memcpy rather than aligned stores
+        for (unsigned int p = 0; p < TilePixels; ++p) {
+            const AccumulatedPixel& pixel = accumulator.pixels[p];
+            const Color mean = (pixel.weight > 0.0f) ? pixel.sum / pixel.weight : Color{0.0f};
+
+            if (m_Format == PixelFormat::Half) {
+                const std::uint16_t halves[3] = {FloatToHalf(mean.x), FloatToHalf(mean.y), FloatToHalf(mean.z)};
+                std::memcpy(packed + p * bytes, halves, sizeof(halves));
+            }
+            else {
+                const std::uint32_t shared = PackRGB9E5(mean);
+                std::memcpy(packed + p * bytes, &shared, sizeof(shared));
+            }
+        }
+
+        m_Accumulators[tile].reset();
+    }
+
+    void Framebuffer::Finish()
+    {
+        for (unsigned int tileY = 0; tileY < m_TilesY; ++tileY) {
+            for (unsigned int tileX = 0; tileX < m_TilesX; ++tileX) {
+                FinishTile(tileX, tileY);
+            }
+        }
+    }
+
+    Color Framebuffer::Decode(std::size_t tile, unsigned int pixel) const
+    {
+        if (m_Accumulators[tile]) {
+            const AccumulatedPixel& accumulated = m_Accumulators[tile]->pixels[pixel];
+            return (accumulated.weight > 0.0f) ? accumulated.sum / accumulated.weight : Color{0.0f};
+        }
+
+        const std::vector<std::uint8_t>& packedRow = m_Packed[tile / m_TilesX];
+
+        if (!m_Finished[tile] || packedRow.empty()) {
+            return Color{0.0f};
+        }
+
+        const std::uint8_t* packed = packedRow.data() + ((tile % m_TilesX) * TilePixels + pixel) * PackedBytes();
+
+        if (m_Format == PixelFormat::Half) {
+            std::uint16_t halves[3];
+            std::memcpy(halves, packed, sizeof(halves));
+
+            return Color{HalfToFloat(halves[0]), HalfToFloat(halves[1]), HalfToFloat(halves[2])};
+        }
+
+        std::uint32_t shared;
+        std::memcpy(&shared, packed, sizeof(shared));
+
+        return UnpackRGB9E5(shared);
+    }
+
+    Color Framebuffer::Pixel(unsigned int i, unsigned int j) const
+    {
+        return Decode(TileIndex(i / TileSize, j / TileSize), MortonIndex(i % TileSize, j % TileSize));
+    }
+
+    void Framebuffer::ResolveRow(unsigned int j, Color* row) const
+    {
+        const unsigned int tileY = j / TileSize;
+        const unsigned int y = j % TileSize;
+
+        for (unsigned int tileX = 0; tileX < m_TilesX; ++tileX) {
+            const std::size_t tile = TileIndex(tileX, tileY);
+            const unsigned int x0 = tileX * TileSize;
+            const unsigned int width = std::min(TileSize, m_Width - x0);
+
+            for (unsigned int x = 0; x < width; ++x) {
+                row[x0 + x] = Decode(tile, MortonIndex(x, y));
+            }
+        }
+    }
+
+    void Framebuffer::Resolve(std::vector<Color>* pixels) const
+    {
+        pixels->resize(static_cast<std::size_t>(m_Width) * m_Height);
+
+        for (unsigned int j = 0; j < m_Height; ++j) {
+            ResolveRow(j, pixels->data() + static_cast<std::size_t>(j) * m_Width);
+        }
+    }
+
+    std::size_t Framebuffer::MemoryUsage() const
+    {
+        const std::size_t liveTiles = std::count_if(m_Accumulators.begin(), m_Accumulators.end(),
+            [](const std::unique_ptr<AccumulatorTile>& tile) { return tile != nullptr; });
+
+        std::size_t packedBytes = 0;
+
+        for (const std::vector<std::uint8_t>& packedRow : m_Packed) {
+            packedBytes += packedRow.size();
+        }
+
+        return liveTiles * sizeof(AccumulatorTile) + packedBytes +
+            m_Accumulators.size() * (sizeof(std::unique_ptr<AccumulatorTile>) + sizeof(std::uint8_t));
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "rtmath.hpp"
+
+namespace RT
+{
+    // Storage of finished pixels, accumulation is always fp32
+    enum class PixelFormat
+    {
+        Float32,
+        Half,
+        RGB9E5
+    };
+
+    // Image accumulated in TileSize x TileSize tiles, pixels in Z-order within a tile. A tile sums
+    // radiance in fp32 until it is finished, then its means are packed into the pixel format and the
+    // accumulator is freed. Finished tiles no longer take samples.
+    class Framebuffer
+    {
+    public:
+        static constexpr unsigned int TileSize = 8;
+        static constexpr unsigned int TilePixels = TileSize * TileSize;
+
+        struct alignas(16) AccumulatedPixel
+        {
+            Color sum;
+            float weight;
+        };
+
+        struct AccumulatorTile
+        {
+            AccumulatedPixel pixels[TilePixels];
+
+            // x and y within the tile
+            void Add(unsigned int x, unsigned int y, const Color& radiance)
+            {
+                AccumulatedPixel& pixel = pixels[MortonIndex(x, y)];
+                pixel.sum += radiance;
+                pixel.weight += 1.0f;
+            }
+        };
+
+        Framebuffer() = default;
+        Framebuffer(unsigned int width, unsigned int height, PixelFormat format) { Reset(width, height, format); }
+
+        // Clears to an empty image, no memory is held for tiles until they take samples
+        void Reset(unsigned int width, unsigned int height, PixelFormat format);
+
+        unsigned int Width() const { return m_Width; }
+        unsigned int Height() const { return m_Height; }
+        unsigned int TilesX() const { return m_TilesX; }
+        unsigned int TilesY() const { return m_TilesY; }
+        PixelFormat Format() const { return m_Format; }
+
+        // Allocated on first use
+        AccumulatorTile& Accumulator(unsigned int tileX, unsigned int tileY);
+
+        void FinishTile(unsigned int tileX, unsigned int tileY);
+        void Finish();
+
+        // Mean radiance, black where no sample was taken
+        Color Pixel(unsigned int i, unsigned int j) const;
+        void ResolveRow(unsigned int j, Color* row) const;
+        void Resolve(std::vector<Color>* pixels) const;
+
+        std::size_t MemoryUsage() const;
+
+        static unsigned int MortonIndex(unsigned int x, unsigned int y)
+        {
+            return Spread(x) | (Spread(y) << 1);
+        }
+
+    private:
+        // 0b abc -> 0b a0b0c
+        static unsigned int Spread(unsigned int v)
+        {
+            return (v & 1u) | ((v & 2u) << 1) | ((v & 4u) << 2);
+        }
+
+        std::size_t TileIndex(unsigned int tileX, unsigned int tileY) const { return static_cast<std::size_t>(tileY) * m_TilesX + tileX; }
+        unsigned int PackedBytes() const;
+
+        Color Decode(std::size_t tile, unsigned int pixel) const;
+
+    private:
+        unsigned int m_Width = 0;
+        unsigned int m_Height = 0;
+        unsigned int m_TilesX = 0;
+        unsigned int m_TilesY = 0;
+        PixelFormat m_Format = PixelFormat::Float32;
+
+        std::vector<std::unique_ptr<AccumulatorTile>> m_Accumulators;
+        std::vector<std::uint8_t> m_Finished;
+
+        // Per row of tiles, PackedBytes() bytes per pixel, allocated when the row's first tile is finished
+        // so accumulators and packed pixels are barely ever held for the same tiles at once. Float32 tiles
+        // keep their accumulator instead.
+        std::vector<std::vector<std::uint8_t>> m_Packed;
+    };
+}
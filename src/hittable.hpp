@@ -1,4 +1,7 @@
 #pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 #include "rtmath.hpp"
 
 namespace RT
@@ -26,5 +29,33 @@ namespace RT
         virtual ~Hittable() = default;
 
         virtual bool Hit(const Ray& ray, const Interval& rayInterval, HitInfo* hitInfo) const = 0;
+        virtual AABB BoundingBox() const = 0;
+
+        // Primitives the object is built from, the triangles of a mesh
+        virtual std::size_t PrimitiveCount() const { return 1; }
+
+        // Acceleration structures the object holds inside, such as a mesh's own BVH
+        virtual std::size_t AccelerationMemoryUsage() const { return 0; }
+
+        // Tests the rays of packet whose bit is set in mask, each over [tMin, tMax[r]]. Bit r of the result
+        // is set when packet.rays[r] hit, which fills hitInfos[r] and lowers tMax[r] to the hit distance.
+        virtual std::uint64_t HitPacket(const RayPacket& packet, std::uint64_t mask, float tMin, float* tMax,
+            HitInfo* hitInfos) const
+        {
+            std::uint64_t hits = 0;
+            HitInfo info;
+
+            for (; mask != 0; mask &= mask - 1) {
+                const unsigned int r = static_cast<unsigned int>(std::countr_zero(mask));
+
+                if (Hit(packet.rays[r], Interval{tMin, tMax[r]}, &info)) {
+                    tMax[r] = info.t;
+                    hitInfos[r] = info;
+                    hits |= std::uint64_t{1} << r;
+                }
+            }
+
+            return hits;
+        }
     };
 }
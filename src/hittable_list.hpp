@@ -36,6 +36,21 @@ namespace RT
             return anyHits;
         }
 
+        virtual AABB BoundingBox() const override
+        {
+            AABB box;
+
+            for (auto& object : m_Objects) {
+                box.Grow(object->BoundingBox());
+            }
+
+            return box;
+        }
+
+        std::size_t Size() const { return m_Objects.size(); }
+
+        std::vector<std::unique_ptr<Hittable>>& Objects() { return m_Objects; }
+
     private:
         std::vector<std::unique_ptr<Hittable>> m_Objects;
     };
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include "irradiance_cache.hpp"
+
+namespace RT
+{
+    IrradianceCache::IrradianceCache(float errorThreshold, float maxErrorThreshold)
+        : m_ErrorThreshold(errorThreshold),
+        m_MaxErrorThreshold(std::max(errorThreshold, maxErrorThreshold)),
+        m_UsedLevels(0)
+    {
+    }
+
+    void IrradianceCache::Clear()
+    {
+        m_Records.clear();
+        m_Cells.clear();
+        m_UsedLevels = 0;
+    }
+
+    int IrradianceCache::Level(float searchRadius)
+    {
+        int exponent = 0;
+        std::frexp(searchRadius, &exponent);
+
+        return std::clamp(exponent, MinLevel, MaxLevel);
+    }
+
+    std::uint64_t IrradianceCache::CellKey(int level, int x, int y, int z)
+    {
+        // 19 bits per axis and 6 for the level, cells wrap around far beyond any sensible scene
+        constexpr std::uint64_t mask = (std::uint64_t{1} << 19) - 1;
+
+        return (static_cast<std::uint64_t>(x) & mask) |
+            ((static_cast<std::uint64_t>(y) & mask) << 19) |
+            ((static_cast<std::uint64_t>(z) & mask) << 38) |
+            (static_cast<std::uint64_t>(level - MinLevel) << 57);
+    }
+
+    int IrradianceCache::CellCoordinate(float coordinate, int level)
+    {
+        return static_cast<int>(std::floor(std::ldexp(coordinate, -level)));
+    }
+
+    void IrradianceCache::Insert(Record record)
+    {
+        // Neighbour clamping (Krivanek et al. 2006): radii may not differ by more than the distance
+        // between records, so a large record cannot reach over a small one into an occluded corner.
+        // Shrunk neighbours stay filed under their old cells, which only costs extra rejected tests.
+        for (std::uint64_t levels = m_UsedLevels; levels != 0; levels &= levels - 1) {
+            const int level = std::countr_zero(levels) + MinLevel;
+            const auto cell = m_Cells.find(CellKey(level, CellCoordinate(record.point.x, level),
+                CellCoordinate(record.point.y, level), CellCoordinate(record.point.z, level)));
+
+            if (cell == m_Cells.end()) {
+                continue;
+            }
+
+            for (const CellEntry& entry : cell->second) {
+                Record& neighbour = m_Records[entry.index];
+                const float distance = Length(neighbour.point - record.point);
+
+                record.radius = std::min(record.radius, neighbour.radius + distance);
+                neighbour.radius = std::max(neighbour.minRadius, std::min(neighbour.radius, record.radius + distance));
+            }
+        }
+
+        record.radius = std::max(record.radius, record.minRadius);
+
+        const float searchRadius = m_MaxErrorThreshold * record.radius;
+        const int level = Level(searchRadius);
+        m_UsedLevels |= std::uint64_t{1} << (level - MinLevel);
+
+        const std::uint32_t index = static_cast<std::uint32_t>(m_Records.size());
+        m_Records.push_back(record);
+
+        const Point3 lo = record.point - Vec3{searchRadius};
+        const Point3 hi = record.point + Vec3{searchRadius};
+
+        for (int x = CellCoordinate(lo.x, level); x <= CellCoordinate(hi.x, level); ++x) {
+            for (int y = CellCoordinate(lo.y, level); y <= CellCoordinate(hi.y, level); ++y) {
+                for (int z = CellCoordinate(lo.z, level); z <= CellCoordinate(hi.z, level); ++z) {
+                    m_Cells[CellKey(level, x, y, z)].push_back(CellEntry{record.point, record.radius, index});
+                }
+            }
+        }
+    }
+
+    bool IrradianceCache::Lookup(const Point3& point, const Vec3& normal, float errorThreshold, float minRadius, float maxRadius,
+        Color* irradiance) const
+    {
+        errorThreshold = std::min(errorThreshold, m_MaxErrorThreshold);
+
+        const float minSearchRadius = m_MaxErrorThreshold * minRadius;
+        const float maxSearchRadius = m_MaxErrorThreshold * maxRadius;
+
+        Color weightedSum{0.0f};
+        float weightSum = 0.0f;
+
+        // Bits Level(minSearchRadius) to Level(maxSearchRadius), both inclusive
+        const int lowBit = Level(minSearchRadius) - MinLevel;
+        const int highBit = Level(std::max(minSearchRadius, maxSearchRadius)) - MinLevel;
+        const std::uint64_t range = (highBit - lowBit == 63) ? ~std::uint64_t{0} :
+            ((std::uint64_t{1} << (highBit - lowBit + 1)) - 1) << lowBit;
+
+        for (std::uint64_t levels = m_UsedLevels & range; levels != 0; levels &= levels - 1) {
+            const int level = std::countr_zero(levels) + MinLevel;
+            const auto cell = m_Cells.find(CellKey(level,
+                CellCoordinate(point.x, level), CellCoordinate(point.y, level), CellCoordinate(point.z, level)));
+
+            if (cell == m_Cells.end()) {
+                continue;
+            }
+
+            for (const CellEntry& entry : cell->second) {
+                const float reach = errorThreshold * entry.radius;
+
+                if (LengthSquared(point - entry.point) >= reach * reach) {
+                    continue;
+                }
+
+                const Record& record = m_Records[entry.index];
+                const Vec3 offset = point - record.point;
+
+                // Records in front of the lookup point see occluders the point cannot
+                if (Dot(offset, 0.5f * (normal + record.normal)) < -0.05f * record.radius) {
+                    continue;
+                }
+
+                const float normalTerm = std::sqrt(std::max(0.0f, 1.0f - Dot(normal, record.normal)));
+                const float error = Length(offset) / record.radius + normalTerm;
+
+                if (error >= errorThreshold) {
+                    continue;
+                }
+
+                // Fades to zero at the edge of the validity area instead of cutting off
+                const float weight = 1.0f / std::max(error, 1.0E-4f) - 1.0f / errorThreshold;
+                const Vec3 rotation = Cross(record.normal, normal);
+
+                Color extrapolated;
+
+                for (int c = 0; c < 3; ++c) {
+                    extrapolated[c] = record.irradiance[c] +
+                        Dot(rotation, record.rotationalGradient[c]) +
+                        Dot(offset, record.translationalGradient[c]);
+                }
+
+                weightedSum += weight * Max(extrapolated, Color{0.0f});
+                weightSum += weight;
+            }
+        }
+
+        if (weightSum <= 0.0f) {
+            return false;
+        }
+
+        *irradiance = weightedSum / weightSum;
+        return true;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "rtmath.hpp"
+
+namespace RT
+{
+    // Ward style irradiance cache: sparse irradiance records with rotational and translational
+    // gradients, stored in a hash grid and interpolated wherever a record's validity area reaches.
+    class IrradianceCache
+    {
+    public:
+        struct Record
+        {
+            Point3 point;
+            Vec3 normal;
+            Color irradiance;
+
+            // Validity radius, from the harmonic mean distance to the surroundings. Neighbour clamping
+            // never shrinks it below minRadius.
+            float radius;
+            float minRadius;
+
+            // Per color channel, in world space
+            Vec3 rotationalGradient[3];
+            Vec3 translationalGradient[3];
+        };
+
+        // errorThreshold is Ward's a, records are trusted up to a * radius away. Lookups may accept
+        // errors up to maxErrorThreshold, records are filed for that reach.
+        IrradianceCache(float errorThreshold, float maxErrorThreshold);
+
+        // Records within errorThreshold of the point, at most maxErrorThreshold. Only those whose radius
+        // lies in [minRadius, maxRadius] are sure to be found, the bounds pick which grid levels are visited.
+        bool Lookup(const Point3& point, const Vec3& normal, float errorThreshold, float minRadius, float maxRadius,
+            Color* irradiance) const;
+        void Insert(Record record);
+
+        void Clear();
+
+        float ErrorThreshold() const { return m_ErrorThreshold; }
+        std::size_t Size() const { return m_Records.size(); }
+
+    private:
+        static constexpr int MinLevel = -32;
+        static constexpr int MaxLevel = 31;
+
+        // Level whose cells are the smallest power of two at least searchRadius wide
+        static int Level(float searchRadius);
+
+        static std::uint64_t CellKey(int level, int x, int y, int z);
+        static int CellCoordinate(float coordinate, int level);
+
+        // Filed in the cells with a copy of what most lookups are rejected on, so those never touch the
+        // record itself. Neighbour clamping only shrinks radii, the copy stays an upper bound.
+        struct CellEntry
+        {
+            Point3 point;
+            float radius;
+            std::uint32_t index;
+        };
+
+    private:
+        float m_ErrorThreshold;
+        float m_MaxErrorThreshold;
+
+        // One grid level per power of two of search distance (maxErrorThreshold * radius), cells of level
+        // l are 2^l wide. A record is stored in every cell its search sphere overlaps on the level whose
+        // cells are at least as wide, so a lookup visits a single cell on each level that holds records
+        // (bit l - MinLevel).
+        std::uint64_t m_UsedLevels;
+
+        std::vector<Record> m_Records;
+        std::unordered_map<std::uint64_t, std::vector<CellEntry>> m_Cells;
+    };
+}
@@ -14,6 +14,12 @@ namespace RT
 
         virtual bool Scatter(const Ray& incident, const HitInfo& hitInfo, Color* attenuation, Ray* scattered) override;
 
+        virtual bool DiffuseAlbedo(Color* albedo) const override
+        {
+            *albedo = m_Albedo;
+            return true;
+        }
+
     private:
         Color m_Albedo;
     };
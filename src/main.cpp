@@ -1,17 +1,35 @@
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 #include "timer.hpp"
 #include "hittable_list.hpp"
-#include "sphere.hpp"
-#include "lambertian.hpp"
-#include "metal.hpp"
-#include "dielectric.hpp"
+#include "bvh.hpp"
+#include "obj_loader.hpp"
+#include "scenes.hpp"
 #include "camera.hpp"
+#include "render_job.hpp"
 
 static void PrintUsage()
 {
     std::cout << "Invalid parameters!\n";
-    std::cout << "Usage: Raytracer [width (px)] [height (px)] [samples] [output file]" << std::endl;
+    std::cout << "Usage: Raytracer [width (px)] [height (px)] [samples] [output file] [options]\n";
+    std::cout << "Options:\n";
+    std::cout << "  --spheres [count]            Render a procedural grid of [count] small spheres instead of the book scene\n";
+    std::cout << "  --obj [file]                 Render a Wavefront OBJ model in place of the book scene's glass sphere\n";
+    std::cout << "  --scene [book | room]        Render the book scene (default) or a diffuse room lit through a skylight\n";
+    std::cout << "  --time-budget [sec]          Render progressively and stop once [sec] seconds have passed\n";
+    std::cout << "  --pass-samples [count]       Samples per pixel added by each progressive pass (default 1)\n";
+    std::cout << "  --snapshot-interval [sec]    Rewrite the output file every [sec] seconds while rendering\n";
+    std::cout << "  --snapshot-passes [count]    Rewrite the output file every [count] passes while rendering\n";
+    std::cout << "  --packet-size [size]         Trace primary rays in [size]x[size] pixel packets, 1 to 8 (default 8)\n";
+    std::cout << "  --pixel-format [format]      Storage of finished pixels: fp32, fp16 or rgb9e5 (default fp16)\n";
+    std::cout << "  --gamma [1 | 2 | 2.2]        Output gamma, 2 is the book's square root (default 2.2)\n";
+    std::cout << "  --irradiance-cache [error]   Shade Lambertian surfaces from an irradiance cache with error threshold [error] (e.g. 0.3)\n";
+    std::cout << "  --environment [file]         Light the scene with a lat-long PFM environment map, or 'sunsky' for a built-in one" << std::endl;
 }
 
 static unsigned int GetUIntArg(const char* const arg)
@@ -20,13 +38,19 @@ static unsigned int GetUIntArg(const char* const arg)
     return (r <= 0 ? 0 : r);
 }
 
+static float GetFloatArg(const char* const arg)
+{
+    const float r = static_cast<float>(std::atof(arg));
+    return (r <= 0.0f ? 0.0f : r);
+}
+
 int main(int argc, char* argv[])
 {
     using namespace RT;
 
     Timer executionTimer{};
 
-    if (argc != 5) {
+    if (argc < 5) {
         PrintUsage();
         return EXIT_FAILURE;
     }
@@ -36,63 +60,220 @@ int main(int argc, char* argv[])
     const unsigned int samples = GetUIntArg(argv[3]);
     const char* const filename = argv[4];
 
-    if (imageWidth == 0 || imageHeight == 0 || samples == 0) {
+    unsigned int sphereCount = 0;
+    const char* objFilename = nullptr;
+    bool room = false;
+    const char* environmentFilename = nullptr;
+    float timeBudget = 0.0f;
+    unsigned int passSamples = 0;
+    float snapshotInterval = 0.0f;
+    unsigned int snapshotPasses = 0;
+    unsigned int packetSize = 8;
+    float irradianceCacheError = 0.0f;
+    OutputTransform outputTransform = OutputTransform::Gamma22;
+    PixelFormat pixelFormat = PixelFormat::Half;
+
+    // Every option takes a single positive value, a filename or a name
+    for (int arg = 5; arg < argc; ++arg) {
+        const std::string option = argv[arg];
+
+        if (arg + 1 >= argc) {
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+
+        const char* const value = argv[++arg];
+        bool valid = false;
+
+        if (option == "--spheres") {
+            sphereCount = GetUIntArg(value);
+
+            // Leaves room for the ground and the three large spheres
+            valid = sphereCount > 0 && sphereCount <= QBVH::MaxPrimitives - 4;
+        }
+        else if (option == "--obj") {
+            objFilename = value;
+            valid = true;
+        }
+        else if (option == "--scene") {
+            const std::string name = value;
+            valid = name == "book" || name == "room";
+            room = name == "room";
+        }
+        else if (option == "--time-budget") {
+            timeBudget = GetFloatArg(value);
+            valid = timeBudget > 0.0f;
+        }
+        else if (option == "--pass-samples") {
+            passSamples = GetUIntArg(value);
+            valid = passSamples > 0;
+        }
+        else if (option == "--snapshot-interval") {
+            snapshotInterval = GetFloatArg(value);
+            valid = snapshotInterval > 0.0f;
+        }
+        else if (option == "--snapshot-passes") {
+            snapshotPasses = GetUIntArg(value);
+            valid = snapshotPasses > 0;
+        }
+        else if (option == "--packet-size") {
+            packetSize = GetUIntArg(value);
+            valid = packetSize > 0 && packetSize <= 8;
+        }
+        else if (option == "--pixel-format") {
+            const std::string format = value;
+            valid = format == "fp32" || format == "fp16" || format == "rgb9e5";
+            pixelFormat = (format == "fp32") ? PixelFormat::Float32 :
+                (format == "rgb9e5") ? PixelFormat::RGB9E5 : PixelFormat::Half;
+        }
+        else if (option == "--gamma") {
+            const float gamma = GetFloatArg(value);
+            valid = gamma == 1.0f || gamma == 2.0f || gamma == 2.2f;
+            outputTransform = (gamma == 1.0f) ? OutputTransform::Linear :
+                (gamma == 2.0f) ? OutputTransform::Gamma2 : OutputTransform::Gamma22;
+        }
+        else if (option == "--environment") {
+            environmentFilename = value;
+            valid = true;
+        }
+        else if (option == "--irradiance-cache") {
+            irradianceCacheError = GetFloatArg(value);
+            valid = irradianceCacheError > 0.0f;
+        }
+
+        if (!valid) {
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The room has no place for the sphere grid or a model
+    if (imageWidth == 0 || imageHeight == 0 || samples == 0 || (room && (sphereCount > 0 || objFilename != nullptr))) {
         PrintUsage();
         return EXIT_FAILURE;
     }
 
     std::cout << "Raytracing [" << imageWidth << "x" << imageHeight << "] " << samples << " samples image to file: " << filename << std::endl;
 
-    HittableList world;
+    HittableList scene;
+
+    if (sphereCount > 0) {
+        StressScene(&scene, sphereCount);
+    }
+    else if (objFilename != nullptr) {
+        std::vector<Point3> vertices;
+        std::vector<std::uint32_t> indices;
+
+        Timer loadTimer{};
 
-    world.Add<Sphere>(Point3{0.0f, -1000.0f, 0.0f}, 1000.0f, std::make_unique<Lambertian>(Color{0.5f, 0.5f, 0.5f}));
+        if (!LoadOBJ(objFilename, &vertices, &indices)) {
+            std::cerr << "Failed to load OBJ file: " << objFilename << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "OBJ: " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, loaded in "
+            << (loadTimer.Peek() * 60.0) << " sec" << std::endl;
+
+        if (indices.size() / 3 > QBVH::MaxPrimitives) {
+            std::cerr << "OBJ file has more than " << QBVH::MaxPrimitives << " triangles: " << objFilename << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        Timer meshTimer{};
+        MeshScene(&scene, std::move(vertices), std::move(indices));
+
+        std::cout << "Mesh BVH built in " << (meshTimer.Peek() * 60.0) << " sec" << std::endl;
+    }
+    else if (room) {
+        RoomScene(&scene);
+    }
+    else {
+        BookScene(&scene);
+    }
+
+    Timer buildTimer{};
+    const BVH world{std::move(scene)};
 
-    for (int a = -11; a < 11; ++a) {
-        for (int b = -11; b < 11; ++b) {
-            const float randomMaterial = RandomFloat();
-            const Point3 center = Point3{a + 0.9f * RandomFloat(), 0.2f, b + 0.9f * RandomFloat()};
+    std::cout << "BVH: " << world.Size() << " objects, " << world.PrimitiveCount() << " primitives, " << world.NodeCount()
+        << " nodes, " << world.MemoryUsage() / (1024.0 * 1024.0) << " MiB ("
+        << static_cast<double>(world.MemoryUsage()) / world.PrimitiveCount() << " bytes/primitive), built in "
+        << (buildTimer.Peek() * 60.0) << " sec" << std::endl;
+
+    CameraSettings cameraSettings = room ? RoomCamera(imageWidth, imageHeight, samples) : BookCamera(imageWidth, imageHeight, samples);
+
+    if (environmentFilename != nullptr && std::string{environmentFilename} == "sunsky") {
+        cameraSettings.background = BackgroundModel::Environment;
+        cameraSettings.environment = SunSkyEnvironment();
+    }
+    else if (environmentFilename != nullptr) {
+        auto environment = std::make_shared<EnvironmentMap>();
 
-            if (Length(center - Point3{4.0f, 0.2f, 0.0f}) > 0.9f) {
-                if (randomMaterial < 0.5f) {
-                    const Color albedo = Hadamard(RandomVec3(), RandomVec3());
-                    world.Add<Sphere>(center, 0.2f, std::make_unique<Lambertian>(albedo));
-                }
-                else if (randomMaterial < 0.90f) {
-                    const Color albedo = RandomVec3(0.5f, 1.0f);
-                    const float fuzz = RandomFloat(0.0f, 0.5f);
-                    world.Add<Sphere>(center, 0.2f, std::make_unique<Metal>(albedo, fuzz));
-                }
-                else {
-                    world.Add<Sphere>(center, 0.2f, std::make_unique<Dielectric>(1.5f));
-                }
-            }
+        if (!environment->Load(environmentFilename)) {
+            std::cerr << "Failed to load environment map: " << environmentFilename << std::endl;
+            return EXIT_FAILURE;
         }
+
+        std::cout << "Environment map: [" << environment->Width() << "x" << environment->Height() << "], "
+            << environment->MemoryUsage() / (1024.0 * 1024.0) << " MiB" << std::endl;
+
+        cameraSettings.background = BackgroundModel::Environment;
+        cameraSettings.environment = std::move(environment);
     }
 
-    world.Add<Sphere>(Point3{0.0f, 1.0f, 0.0f}, 1.0f, std::make_unique<Dielectric>(1.5f));
-    world.Add<Sphere>(Point3{-4.0f, 1.0f, 0.0f}, 1.0f, std::make_unique<Lambertian>(Color{0.4f, 0.2f, 0.1f}));
-    world.Add<Sphere>(Point3{4.0f, 1.0f, 0.0f}, 1.0f, std::make_unique<Metal>(Color{0.7f, 0.6f, 0.5f}, 0.0f));
+    cameraSettings.timeBudget = timeBudget;
+    cameraSettings.passSamples = passSamples;
+    cameraSettings.snapshotInterval = snapshotInterval;
+    cameraSettings.snapshotPasses = snapshotPasses;
+    cameraSettings.packetSize = packetSize;
+    cameraSettings.irradianceCacheError = irradianceCacheError;
+    cameraSettings.outputTransform = outputTransform;
+    cameraSettings.pixelFormat = pixelFormat;
 
-    CameraSettings cameraSettings;
-    cameraSettings.imageWidth = imageWidth;
-    cameraSettings.imageHeight = imageHeight;
+    if (snapshotInterval > 0.0f || snapshotPasses > 0) {
+        cameraSettings.snapshotFilename = filename;
+    }
 
-    cameraSettings.samples = static_cast<int>(samples);
-    cameraSettings.maxTracingDepth = 50;
+    // Only touch the console when the whole percentage changes
+    int lastPercent = -1;
 
-    cameraSettings.position = Vec3{13.0f, 2.0f, 3.0f};
-    cameraSettings.lookAt = Vec3{0.0f, 0.0f, 0.0f};
-    cameraSettings.verticalFOV = 20.0f;
+    const RenderJob job{cameraSettings, world, [&lastPercent](const RenderProgress& progress) {
+        const int percent = static_cast<int>(progress.fraction * 100.0f);
 
-    cameraSettings.defocusAngle = 0.6f;
-    cameraSettings.focalDistance = 10.0f;
+        if (percent != lastPercent) {
+            lastPercent = percent;
+            std::cout << "\rRendering: " << percent << "% (" << progress.samples << "/" << progress.targetSamples
+                << " samples) " << std::flush;
+        }
+    }};
+
+    const RenderResult& result = job.Wait();
+
+    if (result.snapshotFailures > 0) {
+        std::cerr << "\nFailed to write " << result.snapshotFailures << " snapshots to: " << filename << std::endl;
+    }
 
-    Camera camera{cameraSettings};
+    std::cout << "\rWriting PPM file...                         " << std::flush;
 
-    if (!camera.Render(filename, world)) {
+    if (!Camera::WriteImage(filename, result.image, outputTransform)) {
+        std::cerr << "\nFailed to write PPM file: " << filename << std::endl;
         return EXIT_FAILURE;
     }
 
+    std::cout << "\rDone!                                       \n" << std::flush;
+
+    if (result.samples < samples) {
+        std::cout << "Samples rendered: " << result.samples << " of " << samples << std::endl;
+    }
+
+    if (irradianceCacheError > 0.0f) {
+        std::cout << "Irradiance cache: " << result.irradianceRecords << " records" << std::endl;
+    }
+
+    std::cout << "Framebuffer: " << result.image.MemoryUsage() / (1024.0 * 1024.0) << " MiB" << std::endl;
+
+    std::cout << "Rays traced: " << result.rays << " ("
+        << (result.rays / result.seconds) / 1.0E6 << " Mrays/sec)" << std::endl;
+
     // In minutes
     const double timeTaken = executionTimer.Peek();
 
@@ -0,0 +1,136 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace RT
+{
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+#ifdef _WIN32
+    bool MappedFile::Open(const char* filename)
+    {
+        Close();
+
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        m_File = file;
+
+        LARGE_INTEGER size;
+
+        if (!GetFileSizeEx(file, &size)) {
+            Close();
+            return false;
+        }
+
+        if (size.QuadPart == 0) {
+            return true;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (mapping == nullptr) {
+            Close();
+            return false;
+        }
+
+        m_Mapping = mapping;
+        m_Data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+        if (m_Data == nullptr) {
+            Close();
+            return false;
+        }
+
+        m_Size = static_cast<std::size_t>(size.QuadPart);
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (m_Data != nullptr) {
+            UnmapViewOfFile(m_Data);
+        }
+
+        if (m_Mapping != nullptr) {
+            CloseHandle(m_Mapping);
+        }
+
+        if (m_File != nullptr) {
+            CloseHandle(m_File);
+        }
+
+        m_Data = nullptr;
+        m_Size = 0;
+        m_Mapping = nullptr;
+        m_File = nullptr;
+    }
+#else
+    bool MappedFile::Open(const char* filename)
+    {
+        Close();
+
+        m_Descriptor = open(filename, O_RDONLY);
+
+        if (m_Descriptor < 0) {
+            return false;
+        }
+
+        struct stat status;
+
+        if (fstat(m_Descriptor, &status) != 0) {
+            Close();
+            return false;
+        }
+
+        if (status.st_size == 0) {
+            return true;
+        }
+
+        void* data = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, m_Descriptor, 0);
+
+        if (data == MAP_FAILED) {
+            Close();
+            return false;
+        }
+
+        // Parsers walk the file front to back, let the kernel read ahead
+        madvise(data, static_cast<std::size_t>(status.st_size), MADV_WILLNEED);
+
+        m_Data = static_cast<const char*>(data);
+        m_Size = static_cast<std::size_t>(status.st_size);
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (m_Data != nullptr) {
+            munmap(const_cast<char*>(m_Data), m_Size);
+        }
+
+        if (m_Descriptor >= 0) {
+            close(m_Descriptor);
+        }
+
+        m_Data = nullptr;
+        m_Size = 0;
+        m_Descriptor = -1;
+    }
+#endif
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+
+namespace RT
+{
+    // Read only memory mapping of a whole file, unmapped on destruction
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const char* filename);
+        void Close();
+
+        // Null for empty files
+        const char* Data() const { return m_Data; }
+        std::size_t Size() const { return m_Size; }
+
+    private:
+        const char* m_Data = nullptr;
+        std::size_t m_Size = 0;
+
+#ifdef _WIN32
+        void* m_File = nullptr;
+        void* m_Mapping = nullptr;
+#else
+        int m_Descriptor = -1;
+#endif
+    };
+}
@@ -11,5 +11,12 @@ namespace RT
         virtual ~Material() = default;
 
         virtual bool Scatter(const Ray& incident, const HitInfo& hitInfo, Color* attenuation, Ray* scattered) = 0;
+
+        // Ideal diffuse materials report their albedo, which lets the camera shade them from cached irradiance
+        virtual bool DiffuseAlbedo(Color* albedo) const
+        {
+            (void)albedo;
+            return false;
+        }
     };
 }
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include "mapped_file.hpp"
+#include "obj_loader.hpp"
+
+namespace RT
+{
+    // Smaller files are not worth the thread start up
+    static constexpr std::size_t s_MinChunkSize = std::size_t{1} << 20;
+
+    struct ObjChunk
+    {
+        const char* begin;
+        const char* end;
+
+        std::vector<Point3> vertices;
+
+        // Positive OBJ indices are absolute. Negative ones count back from the last vertex read, which may
+        // sit in an earlier chunk, so they are stored relative to the chunk's first vertex and listed in relative.
+        std::vector<std::int64_t> indices;
+        std::vector<std::size_t> relative;
+
+        bool valid = true;
+    };
+
+    static bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    static const char* SkipSpaces(const char* p, const char* end)
+    {
+        while (p < end && IsSpace(*p)) {
+            ++p;
+        }
+
+        return p;
+    }
+
+    static bool ParseFloat(const char** p, const char* end, float* value)
+    {
+        const char* begin = SkipSpaces(*p, end);
+
+        // from_chars takes no explicit plus sign
+        if (begin < end && *begin == '+') {
+            ++begin;
+        }
+
+        const auto [next, error] = std::from_chars(begin, end, *value);
+        *p = next;
+
+        return error == std::errc{};
+    }
+
+    static bool ParseVertex(const char* p, const char* lineEnd, ObjChunk* chunk)
+    {
+        Point3 vertex;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            if (!ParseFloat(&p, lineEnd, &vertex[axis])) {
+                return false;
+            }
+        }
+
+        chunk->vertices.emplace_back(vertex);
+        return true;
+    }
+
+    struct FaceIndex
+    {
+        std::int64_t index;
+        bool relative;
+    };
+
+    static bool ParseFace(const char* p, const char* lineEnd, ObjChunk* chunk, std::vector<FaceIndex>* polygon)
+    {
+        polygon->clear();
+
+        const std::int64_t vertexCount = static_cast<std::int64_t>(chunk->vertices.size());
+
+        for (p = SkipSpaces(p, lineEnd); p < lineEnd && *p != '#'; p = SkipSpaces(p, lineEnd)) {
+            std::int64_t index = 0;
+            const auto [next, error] = std::from_chars(p, lineEnd, index);
+
+            if (error != std::errc{} || index == 0) {
+                return false;
+            }
+
+            if (index > 0) {
+                polygon->emplace_back(FaceIndex{index - 1, false});
+            }
+            else {
+                polygon->emplace_back(FaceIndex{vertexCount + index, true});
+            }
+
+            // Skip the texture coordinate and normal of v/vt/vn
+            p = next;
+
+            while (p < lineEnd && !IsSpace(*p)) {
+                ++p;
+            }
+        }
+
+        if (polygon->size() < 3) {
+            return false;
+        }
+
+        auto emit = [chunk](const FaceIndex& faceIndex) {
+            if (faceIndex.relative) {
+                chunk->relative.emplace_back(chunk->indices.size());
+            }
+
+            chunk->indices.emplace_back(faceIndex.index);
+        };
+
+        for (std::size_t k = 1; k + 1 < polygon->size(); ++k) {
+            emit((*polygon)[0]);
+            emit((*polygon)[k]);
+            emit((*polygon)[k + 1]);
+        }
+
+        return true;
+    }
+
+    static void ParseChunk(ObjChunk* chunk)
+    {
+        std::vector<FaceIndex> polygon;
+        const char* p = chunk->begin;
+
+        while (p < chunk->end) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk->end - p));
+
+            if (lineEnd == nullptr) {
+                lineEnd = chunk->end;
+            }
+
+            p = SkipSpaces(p, lineEnd);
+
+            if (lineEnd - p >= 2 && IsSpace(p[1])) {
+                bool valid = true;
+
+                if (p[0] == 'v') {
+                    valid = ParseVertex(p + 1, lineEnd, chunk);
+                }
+                else if (p[0] == 'f') {
+                    valid = ParseFace(p + 1, lineEnd, chunk, &polygon);
+                }
+
+                if (!valid) {
+                    chunk->valid = false;
+                    return;
+                }
+            }
+
+            p = (lineEnd < chunk->end) ? lineEnd + 1 : chunk->end;
+        }
+    }
+
+    template<typename F>
+    static void ParallelFor(std::size_t count, F&& function)
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(count);
+
+        for (std::size_t i = 1; i < count; ++i) {
+            threads.emplace_back(function, i);
+        }
+
+        if (count > 0) {
+            function(std::size_t{0});
+        }
+
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    static bool ParseOBJ(const MappedFile& file, std::size_t chunkCount, std::vector<Point3>* vertices, std::vector<std::uint32_t>* indices)
+    {
+        const char* const data = file.Data();
+        const std::size_t size = file.Size();
+
+        // No faces, and an empty mapping has no data to cut into chunks
+        if (size == 0) {
+            return false;
+        }
+
+        // Cut at even offsets, then move every cut past the end of the line it landed in
+        std::vector<ObjChunk> chunks(chunkCount);
+        const char* begin = data;
+
+        for (std::size_t c = 0; c < chunkCount; ++c) {
+            const char* end = data + size;
+
+            if (c + 1 < chunkCount) {
+                end = std::max(begin, data + size * (c + 1) / chunkCount - 1);
+                const char* newline = static_cast<const char*>(std::memchr(end, '\n', data + size - end));
+                end = (newline != nullptr) ? newline + 1 : data + size;
+            }
+
+            chunks[c].begin = begin;
+            chunks[c].end = end;
+            begin = end;
+        }
+
+        ParallelFor(chunkCount, [&chunks](std::size_t c) { ParseChunk(&chunks[c]); });
+
+        std::vector<std::size_t> vertexOffsets(chunkCount + 1, 0);
+        std::vector<std::size_t> indexOffsets(chunkCount + 1, 0);
+
+        for (std::size_t c = 0; c < chunkCount; ++c) {
+            if (!chunks[c].valid) {
+                return false;
+            }
+
+            vertexOffsets[c + 1] = vertexOffsets[c] + chunks[c].vertices.size();
+            indexOffsets[c + 1] = indexOffsets[c] + chunks[c].indices.size();
+        }
+
+        const std::size_t vertexCount = vertexOffsets[chunkCount];
+
+        // Nothing to render, and the scene would be scaled around an empty box
+        if (indexOffsets[chunkCount] == 0) {
+            return false;
+        }
+
+        if (vertexCount > std::numeric_limits<std::uint32_t>::max()) {
+            return false;
+        }
+
+        vertices->resize(vertexCount);
+        indices->resize(indexOffsets[chunkCount]);
+
+        std::vector<char> chunkValid(chunkCount, 1);
+
+        ParallelFor(chunkCount, [&](std::size_t c) {
+            ObjChunk& chunk = chunks[c];
+
+            std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices->begin() + vertexOffsets[c]);
+            chunk.vertices = {};
+
+            for (std::size_t offset : chunk.relative) {
+                chunk.indices[offset] += static_cast<std::int64_t>(vertexOffsets[c]);
+            }
+
+            std::uint32_t* out = indices->data() + indexOffsets[c];
+
+            for (std::size_t i = 0; i < chunk.indices.size(); ++i) {
+                const std::int64_t index = chunk.indices[i];
+
+                if (index < 0 || index >= static_cast<std::int64_t>(vertexCount)) {
+                    chunkValid[c] = 0;
+                    return;
+                }
+
+                out[i] = static_cast<std::uint32_t>(index);
+            }
+
+            chunk.indices = {};
+        });
+
+        return std::all_of(chunkValid.begin(), chunkValid.end(), [](char valid) { return valid != 0; });
+    }
+
+    bool LoadOBJ(const char* filename, std::vector<Point3>* vertices, std::vector<std::uint32_t>* indices)
+    {
+        MappedFile file;
+
+        if (!file.Open(filename)) {
+            return false;
+        }
+
+        const std::size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+        const std::size_t chunkCount = std::clamp(file.Size() / s_MinChunkSize, std::size_t{1}, threadCount);
+
+        return ParseOBJ(file, chunkCount, vertices, indices);
+    }
+
+    bool LoadOBJ(const char* filename, std::vector<Point3>* vertices, std::vector<std::uint32_t>* indices, std::size_t chunkCount)
+    {
+        MappedFile file;
+
+        if (chunkCount == 0 || !file.Open(filename)) {
+            return false;
+        }
+
+        return ParseOBJ(file, chunkCount, vertices, indices);
+    }
+}
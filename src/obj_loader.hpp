@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "rtmath.hpp"
+
+namespace RT
+{
+    // Reads the vertex positions and faces of a Wavefront OBJ file, polygons are fan triangulated into
+    // three indices per triangle. Normals, texture coordinates, groups and materials are ignored.
+    // The file is memory mapped and parsed in parallel chunks of whole lines. Fails on malformed lines,
+    // indices past the vertex list and files without a single face.
+    bool LoadOBJ(const char* filename, std::vector<Point3>* vertices, std::vector<std::uint32_t>* indices);
+
+    // Parses in chunkCount chunks whatever the file size, so small test files cover the chunk merging
+    bool LoadOBJ(const char* filename, std::vector<Point3>* vertices, std::vector<std::uint32_t>* indices, std::size_t chunkCount);
+}
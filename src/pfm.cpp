@@ -0,0 +1,89 @@
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include "pfm.hpp"
+
+namespace RT
+{
+    static std::uint32_t SwapBytes(std::uint32_t v)
+    {
+        return (v >> 24) | ((v >> 8) & 0x0000FF00u) | ((v << 8) & 0x00FF0000u) | (v << 24);
+    }
+
+    bool WritePFM(const char* filename, unsigned int width, unsigned int height, const float* pixels)
+    {
+        std::ofstream pfmFile{filename, std::ios::binary};
+
+        if (!pfmFile.is_open()) {
+            return false;
+        }
+
+        // A negative scale marks little endian data
+        const bool littleEndian = std::endian::native == std::endian::little;
+        pfmFile << "PF\n" << width << " " << height << "\n" << (littleEndian ? "-1.0" : "1.0") << "\n";
+
+        // Rows are stored bottom to top
+        for (unsigned int j = height; j-- > 0;) {
+            pfmFile.write(reinterpret_cast<const char*>(pixels + static_cast<std::size_t>(j) * width * 3),
+                static_cast<std::streamsize>(width * 3 * sizeof(float)));
+        }
+
+        return pfmFile.good();
+    }
+
+    bool ReadPFM(const char* filename, unsigned int* width, unsigned int* height, std::vector<float>* pixels)
+    {
+        std::ifstream pfmFile{filename, std::ios::binary};
+
+        if (!pfmFile.is_open()) {
+            return false;
+        }
+
+        std::string magic;
+        float scale = 0.0f;
+
+        pfmFile >> magic >> *width >> *height >> scale;
+
+        const unsigned int channels = (magic == "PF") ? 3 : (magic == "Pf") ? 1 : 0;
+
+        if (!pfmFile || channels == 0 || *width == 0 || *height == 0) {
+            return false;
+        }
+
+        // Exactly one whitespace character separates the header from the data
+        pfmFile.get();
+
+        const std::size_t rowValues = static_cast<std::size_t>(*width) * channels;
+        std::vector<float> row(rowValues);
+        pixels->resize(static_cast<std::size_t>(*width) * *height * 3);
+
+        const bool swap = (scale < 0.0f) != (std::endian::native == std::endian::little);
+
+        for (unsigned int j = *height; j-- > 0;) {
+            if (!pfmFile.read(reinterpret_cast<char*>(row.data()), static_cast<std::streamsize>(rowValues * sizeof(float)))) {
+                return false;
+            }
+
+            for (std::size_t v = 0; v < rowValues; ++v) {
+                if (swap) {
+                    std::uint32_t bits;
+                    std::memcpy(&bits, &row[v], sizeof(bits));
+                    bits = SwapBytes(bits);
+                    std::memcpy(&row[v], &bits, sizeof(bits));
+                }
+            }
+
+            float* out = pixels->data() + static_cast<std::size_t>(j) * *width * 3;
+
+            for (unsigned int i = 0; i < *width; ++i) {
+                for (unsigned int c = 0; c < 3; ++c) {
+                    out[i * 3 + c] = row[i * channels + (channels == 3 ? c : 0)];
+                }
+            }
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <vector>
+
+namespace RT
+{
+    // Portable float map, linear RGB stored as 32-bit floats. Pixels are top to bottom, row major.
+    bool WritePFM(const char* filename, unsigned int width, unsigned int height, const float* pixels);
+    bool ReadPFM(const char* filename, unsigned int* width, unsigned int* height, std::vector<float>* pixels);
+}
@@ -1,9 +1,22 @@
+#include <algorithm>
+#include <cstddef>
 #include <fstream>
+#include <vector>
 #include "ppm.hpp"
 
 namespace RT
 {
     bool WritePPM(const char* filename, unsigned int width, unsigned int height, const float* pixels)
+    {
+        constexpr unsigned int bpp = 3;
+
+        return WritePPM(filename, width, height, [&](unsigned int row, float* rowPixels) {
+            const float* source = pixels + static_cast<std::size_t>(row) * width * bpp;
+            std::copy(source, source + width * bpp, rowPixels);
+        });
+    }
+
+    bool WritePPM(const char* filename, unsigned int width, unsigned int height, const PixelRowSource& source)
     {
         // Bytes per pixel
         constexpr unsigned int bpp = 3;
@@ -16,18 +29,20 @@ namespace RT
 
         ppmFile << "P3\n" << width << " " << height << "\n255\n";
 
+        std::vector<float> pixels(static_cast<std::size_t>(width) * bpp);
+
         for (unsigned int j = 0; j < height; ++j) {
-            for (unsigned int i = 0; i < width * bpp; i += bpp) {
-                const unsigned int index = j * width * bpp + i;
+            source(j, pixels.data());
 
-                const unsigned int& r = static_cast<unsigned int>(255.0f * pixels[index + 0]);
-                const unsigned int& g = static_cast<unsigned int>(255.0f * pixels[index + 1]);
-                const unsigned int& b = static_cast<unsigned int>(255.0f * pixels[index + 2]);
+            for (unsigned int i = 0; i < width * bpp; i += bpp) {
+                const unsigned int& r = static_cast<unsigned int>(255.0f * pixels[i + 0]);
+                const unsigned int& g = static_cast<unsigned int>(255.0f * pixels[i + 1]);
+                const unsigned int& b = static_cast<unsigned int>(255.0f * pixels[i + 2]);
 
                 ppmFile << r << " " << g << " " << b << "\n";
             }
         }
 
-        return true;
+        return ppmFile.good();
     }
 }
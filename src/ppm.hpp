@@ -1,7 +1,12 @@
 #pragma once
 #include <cstdint>
+#include <functional>
 
 namespace RT
 {
+    // Fills one row of width RGB triples in [0, 1], rows are requested top to bottom
+    using PixelRowSource = std::function<void(unsigned int row, float* pixels)>;
+
     bool WritePPM(const char* filename, unsigned int width, unsigned int height, const float* pixels);
+    bool WritePPM(const char* filename, unsigned int width, unsigned int height, const PixelRowSource& source);
 }
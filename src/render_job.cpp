@@ -0,0 +1,46 @@
+#include <exception>
+#include <utility>
+#include "timer.hpp"
+#include "render_job.hpp"
+
+namespace RT
+{
+    RenderJob::RenderJob(const CameraSettings& settings, const Hittable& world, Camera::ProgressCallback onProgress)
+        : m_Camera(settings)
+    {
+        m_Camera.SetProgressCallback(std::move(onProgress));
+
+        std::promise<RenderResult> promise;
+        m_Result = promise.get_future().share();
+
+        m_Thread = std::thread([this, &world, promise = std::move(promise)]() mutable {
+            try {
+                RenderResult result;
+
+                Timer timer{};
+                m_Camera.Render(world, &result.image);
+
+                result.seconds = timer.PeekSeconds();
+                result.samples = m_Camera.SamplesRendered();
+                result.rays = m_Camera.RayCount();
+                result.irradianceRecords = m_Camera.IrradianceRecords();
+                result.snapshotFailures = m_Camera.SnapshotFailures();
+                result.cancelled = m_Camera.Cancelled();
+
+                promise.set_value(std::move(result));
+            }
+            catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        });
+    }
+
+    RenderJob::~RenderJob()
+    {
+        m_Camera.Cancel();
+
+        if (m_Thread.joinable()) {
+            m_Thread.join();
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include "framebuffer.hpp"
+#include "camera.hpp"
+
+namespace RT
+{
+    struct RenderResult
+    {
+        // Linear radiance, finished
+        Framebuffer image;
+
+        unsigned int samples = 0;
+        std::uint64_t rays = 0;
+        double seconds = 0.0;
+        std::size_t irradianceRecords = 0;
+        unsigned int snapshotFailures = 0;
+        bool cancelled = false;
+    };
+
+    // Renders on a thread of its own, for embedding the renderer in other tools. Jobs are
+    // independent and may run concurrently, as long as each scene outlives the jobs using it
+    // and is not modified while they run.
+    class RenderJob
+    {
+    public:
+        // Starts rendering right away. onProgress is called on the job's thread.
+        RenderJob(const CameraSettings& settings, const Hittable& world, Camera::ProgressCallback onProgress = {});
+
+        // Cancels the render if it is still running and waits for the thread to finish
+        ~RenderJob();
+
+        RenderJob(const RenderJob&) = delete;
+        RenderJob& operator=(const RenderJob&) = delete;
+
+        // Cooperative, the render stops at its next row of tiles and the result keeps what was done
+        void Cancel() { m_Camera.Cancel(); }
+
+        float Progress() const { return m_Camera.Progress(); }
+        bool Done() const { return m_Result.wait_for(std::chrono::seconds{0}) == std::future_status::ready; }
+
+        std::shared_future<RenderResult> Result() const { return m_Result; }
+        const RenderResult& Wait() const { return m_Result.get(); }
+
+    private:
+        Camera m_Camera;
+        std::shared_future<RenderResult> m_Result;
+        std::thread m_Thread;
+    };
+}
@@ -3,15 +3,27 @@
 
 namespace RT
 {
-    static std::random_device s_RD{};
-    static std::seed_seq seed{s_RD(), s_RD(), s_RD(), s_RD(), s_RD(), s_RD(), s_RD(), s_RD()};
+    // One generator per thread so concurrent renders neither race nor share a sequence
+    static std::mt19937 CreateRNG()
+    {
+        std::random_device rd{};
+        std::seed_seq seed{rd(), rd(), rd(), rd(), rd(), rd(), rd(), rd()};
+
+        return std::mt19937{seed};
+    }
 
-    static std::mt19937 s_RNG{seed};
-    static std::uniform_real_distribution<float> s_Dist{0.0f, 1.0f};
+    static thread_local std::mt19937 s_RNG = CreateRNG();
+
+    void SeedRandom(std::uint32_t seed)
+    {
+        s_RNG.seed(seed);
+    }
 
     float RandomFloat()
     {
-        return s_Dist(s_RNG);
+        // Top 24 bits as a float in [0, 1), unlike std::uniform_real_distribution this is
+        // the same sequence on every standard library, so fixed seed renders are reproducible
+        return static_cast<float>(s_RNG() >> 8) * (1.0f / 16777216.0f);
     }
 
     float RandomFloat(float min, float max)
@@ -19,6 +31,12 @@ namespace RT
         return min + (max - min) * RandomFloat();
     }
 
+    std::uint32_t RandomIndex(std::uint32_t count)
+    {
+        // Lemire's multiply and shift, the bias is at most count / 2^32
+        return static_cast<std::uint32_t>((static_cast<std::uint64_t>(s_RNG()) * count) >> 32);
+    }
+
     const Vec3 RandomVec3()
     {
         return Vec3{RandomFloat(), RandomFloat(), RandomFloat()};
@@ -1,5 +1,6 @@
 #pragma once
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <limits>
 #include <algorithm>
@@ -84,6 +85,27 @@ namespace RT
         return Vec3{a.x * b.x, a.y * b.y, a.z * b.z};
     }
 
+    inline const Vec3 Min(const Vec3& a, const Vec3& b)
+    {
+        return Vec3{std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+    }
+
+    inline const Vec3 Max(const Vec3& a, const Vec3& b)
+    {
+        return Vec3{std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+    }
+
+    // Two unit vectors completing n to a right handed orthonormal basis (Duff et al. 2017)
+    inline void OrthonormalBasis(const Vec3& n, Vec3* b1, Vec3* b2)
+    {
+        const float sign = std::copysign(1.0f, n.z);
+        const float a = -1.0f / (sign + n.z);
+        const float b = n.x * n.y * a;
+
+        *b1 = Vec3{1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x};
+        *b2 = Vec3{b, sign + n.y * n.y * a, -n.y};
+    }
+
     inline bool NearZero(const Vec3& v)
     {
         constexpr float s = 1.0E-5f;
@@ -120,6 +142,21 @@ namespace RT
         Vec3 m_Direction;
     };
 
+    // Bundle of up to 8x8 coherent rays traced together, hits are reported as a bitmask over the rays
+    struct RayPacket
+    {
+        static constexpr unsigned int MaxSize = 64;
+
+        unsigned int size = 0;
+        Ray rays[MaxSize];
+
+        // Bit r set for every ray in the packet
+        std::uint64_t FullMask() const
+        {
+            return (size == MaxSize) ? ~std::uint64_t{0} : (std::uint64_t{1} << size) - 1;
+        }
+    };
+
     class Interval
     {
     public:
@@ -148,8 +185,41 @@ namespace RT
         float m_Max;
     };
 
+    struct AABB
+    {
+        Point3 min;
+        Point3 max;
+
+        AABB() : min(FltInfinity), max(-FltInfinity) {}
+        AABB(const Point3& min, const Point3& max) : min(min), max(max) {}
+
+        void Grow(const Point3& p) { min = Min(min, p); max = Max(max, p); }
+        void Grow(const AABB& box) { min = Min(min, box.min); max = Max(max, box.max); }
+
+        bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+        const Point3 Center() const { return 0.5f * (min + max); }
+        const Vec3 Extent() const { return max - min; }
+
+        float SurfaceArea() const
+        {
+            if (IsEmpty()) {
+                return 0.0f;
+            }
+
+            const Vec3 e = Extent();
+            return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+    };
+
+    // Restarts the random sequence, for reproducible scenes and renders
+    void SeedRandom(std::uint32_t seed);
+
     float RandomFloat();
     float RandomFloat(float min, float max);
+
+    // Uniform in [0, count), for count too large to pick from a float in [0, 1) evenly
+    std::uint32_t RandomIndex(std::uint32_t count);
     const Vec3 RandomVec3();
     const Vec3 RandomVec3(float min, float max);
 
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numbers>
+#include <utility>
+#include "sphere.hpp"
+#include "triangle_mesh.hpp"
+#include "lambertian.hpp"
+#include "metal.hpp"
+#include "dielectric.hpp"
+#include "scenes.hpp"
+
+namespace RT
+{
+    static void AddRandomSphere(HittableList* world, const Point3& center, float randomMaterial)
+    {
+        if (randomMaterial < 0.5f) {
+            const Color albedo = Hadamard(RandomVec3(), RandomVec3());
+            world->Add<Sphere>(center, 0.2f, std::make_unique<Lambertian>(albedo));
+        }
+        else if (randomMaterial < 0.90f) {
+            const Color albedo = RandomVec3(0.5f, 1.0f);
+            const float fuzz = RandomFloat(0.0f, 0.5f);
+            world->Add<Sphere>(center, 0.2f, std::make_unique<Metal>(albedo, fuzz));
+        }
+        else {
+            world->Add<Sphere>(center, 0.2f, std::make_unique<Dielectric>(1.5f));
+        }
+    }
+
+    static void AddLargeSpheres(HittableList* world)
+    {
+        world->Add<Sphere>(Point3{0.0f, 1.0f, 0.0f}, 1.0f, std::make_unique<Dielectric>(1.5f));
+        world->Add<Sphere>(Point3{-4.0f, 1.0f, 0.0f}, 1.0f, std::make_unique<Lambertian>(Color{0.4f, 0.2f, 0.1f}));
+        world->Add<Sphere>(Point3{4.0f, 1.0f, 0.0f}, 1.0f, std::make_unique<Metal>(Color{0.7f, 0.6f, 0.5f}, 0.0f));
+    }
+
+    // The book's 22x22 grid, keeping clear of the metal sphere and of keepOut around the origin
+    static void AddSmallSpheres(HittableList* world, float keepOut)
+    {
+        for (int a = -11; a < 11; ++a) {
+            for (int b = -11; b < 11; ++b) {
+                const float randomMaterial = RandomFloat();
+                const Point3 center = Point3{a + 0.9f * RandomFloat(), 0.2f, b + 0.9f * RandomFloat()};
+
+                if (Length(center - Point3{4.0f, 0.2f, 0.0f}) > 0.9f && Length(Vec3{center.x, 0.0f, center.z}) >= keepOut) {
+                    AddRandomSphere(world, center, randomMaterial);
+                }
+            }
+        }
+    }
+
+    void BookScene(HittableList* world)
+    {
+        world->Add<Sphere>(Point3{0.0f, -1000.0f, 0.0f}, 1000.0f, std::make_unique<Lambertian>(Color{0.5f, 0.5f, 0.5f}));
+
+        AddSmallSpheres(world, 0.0f);
+        AddLargeSpheres(world);
+    }
+
+    // Parallelogram from corner to corner + u + v as two triangles. Hits face the ray, so winding is free.
+    static void AddQuad(std::vector<Point3>* vertices, std::vector<std::uint32_t>* indices, const Point3& corner,
+        const Vec3& u, const Vec3& v)
+    {
+        const std::uint32_t first = static_cast<std::uint32_t>(vertices->size());
+
+        vertices->insert(vertices->end(), {corner, corner + u, corner + u + v, corner + v});
+        indices->insert(indices->end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+    }
+
+    void RoomScene(HittableList* world)
+    {
+        constexpr float halfWidth = 6.0f;
+        constexpr float height = 4.0f;
+        constexpr float halfOpening = 1.5f;
+
+        std::vector<Point3> vertices;
+        std::vector<std::uint32_t> indices;
+
+        // Floor, back wall and side walls, the front at +z is left open
+        AddQuad(&vertices, &indices, Point3{-halfWidth, 0.0f, -halfWidth}, Vec3{0.0f, 0.0f, 2.0f * halfWidth}, Vec3{2.0f * halfWidth, 0.0f, 0.0f});
+        AddQuad(&vertices, &indices, Point3{-halfWidth, 0.0f, -halfWidth}, Vec3{2.0f * halfWidth, 0.0f, 0.0f}, Vec3{0.0f, height, 0.0f});
+        AddQuad(&vertices, &indices, Point3{-halfWidth, 0.0f, -halfWidth}, Vec3{0.0f, height, 0.0f}, Vec3{0.0f, 0.0f, 2.0f * halfWidth});
+        AddQuad(&vertices, &indices, Point3{halfWidth, 0.0f, -halfWidth}, Vec3{0.0f, 0.0f, 2.0f * halfWidth}, Vec3{0.0f, height, 0.0f});
+
+        // Ceiling in four strips around a square opening over the middle
+        const float strip = halfWidth - halfOpening;
+
+        AddQuad(&vertices, &indices, Point3{-halfWidth, height, -halfWidth}, Vec3{2.0f * halfWidth, 0.0f, 0.0f}, Vec3{0.0f, 0.0f, strip});
+        AddQuad(&vertices, &indices, Point3{-halfWidth, height, halfOpening}, Vec3{2.0f * halfWidth, 0.0f, 0.0f}, Vec3{0.0f, 0.0f, strip});
+        AddQuad(&vertices, &indices, Point3{-halfWidth, height, -halfOpening}, Vec3{strip, 0.0f, 0.0f}, Vec3{0.0f, 0.0f, 2.0f * halfOpening});
+        AddQuad(&vertices, &indices, Point3{halfOpening, height, -halfOpening}, Vec3{strip, 0.0f, 0.0f}, Vec3{0.0f, 0.0f, 2.0f * halfOpening});
+
+        world->Add<TriangleMesh>(std::move(vertices), std::move(indices), std::make_unique<Lambertian>(Color{0.7f, 0.7f, 0.7f}));
+
+        AddLargeSpheres(world);
+    }
+
+    void MeshScene(HittableList* world, std::vector<Point3> vertices, std::vector<std::uint32_t> indices)
+    {
+        AABB bounds;
+
+        for (const Point3& vertex : vertices) {
+            bounds.Grow(vertex);
+        }
+
+        // Scale the model to a 2.5 unit box standing on the ground at the origin, where the glass sphere was
+        const Vec3 extent = bounds.Extent();
+        const float largest = std::max({extent.x, extent.y, extent.z});
+        const float scale = (largest > 0.0f) ? 2.5f / largest : 1.0f;
+        const Point3 base{bounds.Center().x, bounds.min.y, bounds.Center().z};
+
+        for (Point3& vertex : vertices) {
+            vertex = (vertex - base) * scale;
+        }
+
+        world->Add<Sphere>(Point3{0.0f, -1000.0f, 0.0f}, 1000.0f, std::make_unique<Lambertian>(Color{0.5f, 0.5f, 0.5f}));
+
+        AddSmallSpheres(world, 0.5f * std::sqrt(extent.x * extent.x + extent.z * extent.z) * scale + 0.2f);
+
+        world->Add<TriangleMesh>(std::move(vertices), std::move(indices), std::make_unique<Lambertian>(Color{0.7f, 0.7f, 0.7f}));
+        world->Add<Sphere>(Point3{-4.0f, 1.0f, 0.0f}, 1.0f, std::make_unique<Lambertian>(Color{0.4f, 0.2f, 0.1f}));
+        world->Add<Sphere>(Point3{4.0f, 1.0f, 0.0f}, 1.0f, std::make_unique<Metal>(Color{0.7f, 0.6f, 0.5f}, 0.0f));
+    }
+
+    void StressScene(HittableList* world, unsigned int sphereCount)
+    {
+        const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(sphereCount))));
+        const int half = side / 2;
+
+        // Grow the ground with the grid and wrap the grid over it, a flat plane of this size
+        // would put the far spheres well above a radius 1000 ground sphere.
+        const float groundRadius = std::max(1000.0f, 4.0f * side);
+        const Point3 groundCenter{0.0f, -groundRadius, 0.0f};
+
+        world->Add<Sphere>(groundCenter, groundRadius, std::make_unique<Lambertian>(Color{0.5f, 0.5f, 0.5f}));
+
+        unsigned int placed = 0;
+
+        // Cells skipped around the metal sphere are made up for by running on into another row
+        for (int a = -half; placed < sphereCount; ++a) {
+            for (int b = -half; b < side - half && placed < sphereCount; ++b) {
+                const float randomMaterial = RandomFloat();
+                const Point3 onPlane = Point3{a + 0.9f * RandomFloat(), 0.0f, b + 0.9f * RandomFloat()};
+                const Point3 center = groundCenter + (groundRadius + 0.2f) * Normalize(onPlane - groundCenter);
+
+                if (Length(center - Point3{4.0f, 0.2f, 0.0f}) > 0.9f) {
+                    AddRandomSphere(world, center, randomMaterial);
+                    ++placed;
+                }
+            }
+        }
+
+        AddLargeSpheres(world);
+    }
+
+    CameraSettings BookCamera(unsigned int imageWidth, unsigned int imageHeight, unsigned int samples)
+    {
+        CameraSettings cameraSettings;
+        cameraSettings.imageWidth = imageWidth;
+        cameraSettings.imageHeight = imageHeight;
+
+        cameraSettings.samples = samples;
+        cameraSettings.maxTracingDepth = 50;
+
+        cameraSettings.position = Vec3{13.0f, 2.0f, 3.0f};
+        cameraSettings.lookAt = Vec3{0.0f, 0.0f, 0.0f};
+        cameraSettings.verticalFOV = 20.0f;
+
+        cameraSettings.defocusAngle = 0.6f;
+        cameraSettings.focalDistance = 10.0f;
+
+        return cameraSettings;
+    }
+
+    CameraSettings RoomCamera(unsigned int imageWidth, unsigned int imageHeight, unsigned int samples)
+    {
+        CameraSettings cameraSettings = BookCamera(imageWidth, imageHeight, samples);
+
+        cameraSettings.position = Vec3{0.0f, 2.0f, 12.0f};
+        cameraSettings.lookAt = Vec3{0.0f, 1.5f, 0.0f};
+        cameraSettings.verticalFOV = 35.0f;
+        cameraSettings.defocusAngle = 0.0f;
+
+        return cameraSettings;
+    }
+
+    std::shared_ptr<const EnvironmentMap> SunSkyEnvironment(unsigned int width, unsigned int height)
+    {
+        constexpr float pi = std::numbers::pi_v<float>;
+
+        // About 30 degrees up, off to the camera's left so shadows fall across the view
+        const Vec3 sunDirection = Normalize(Vec3{-0.3f, 0.55f, 0.78f});
+        const float sunCosine = std::cos(ToRadians(2.0f));
+        const Color sunRadiance = Color{400.0f, 360.0f, 300.0f};
+
+        std::vector<Color> radiance(static_cast<std::size_t>(width) * height);
+
+        for (unsigned int y = 0; y < height; ++y) {
+            const float theta = pi * (y + 0.5f) / height;
+
+            for (unsigned int x = 0; x < width; ++x) {
+                const float phi = 2.0f * pi * (x + 0.5f) / width - pi;
+                const Vec3 direction{std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+
+                Color& pixel = radiance[static_cast<std::size_t>(y) * width + x];
+
+                if (Dot(direction, sunDirection) >= sunCosine) {
+                    pixel = sunRadiance;
+                }
+                else if (direction.y > 0.0f) {
+                    pixel = Lerp(Color{0.35f, 0.4f, 0.45f}, Color{0.1f, 0.2f, 0.4f}, std::sqrt(direction.y));
+                }
+                else {
+                    pixel = Color{0.05f};
+                }
+            }
+        }
+
+        auto environment = std::make_shared<EnvironmentMap>();
+        environment->Reset(width, height, std::move(radiance));
+
+        return environment;
+    }
+
+    CameraSettings SunSkyCamera(unsigned int imageWidth, unsigned int imageHeight, unsigned int samples)
+    {
+        CameraSettings cameraSettings = BookCamera(imageWidth, imageHeight, samples);
+
+        // Built once and shared, cameras only read it
+        static const std::shared_ptr<const EnvironmentMap> s_Environment = SunSkyEnvironment();
+
+        cameraSettings.background = BackgroundModel::Environment;
+        cameraSettings.environment = s_Environment;
+
+        return cameraSettings;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "hittable_list.hpp"
+#include "camera.hpp"
+
+namespace RT
+{
+    // Final scene of the book: three large spheres over a 22x22 grid of small random ones
+    void BookScene(HittableList* world);
+
+    // The book scene's grid loop stretched to sphereCount small spheres, for scaling tests
+    void StressScene(HittableList* world, unsigned int sphereCount);
+
+    // The book scene with a triangle mesh in place of the glass sphere, scaled to fit. The mesh needs at
+    // least one triangle, as LoadOBJ guarantees.
+    void MeshScene(HittableList* world, std::vector<Point3> vertices, std::vector<std::uint32_t> indices);
+
+    // Grey room open at the front and lit by the sky through an opening in its ceiling, with the book's
+    // three large spheres on the floor. Nearly all light seen has bounced off the walls, several times over.
+    void RoomScene(HittableList* world);
+
+    // The book's final camera: looking from (13, 2, 3) at the origin with a shallow depth of field
+    CameraSettings BookCamera(unsigned int imageWidth, unsigned int imageHeight, unsigned int samples);
+
+    // Looking into RoomScene through its open front, without depth of field
+    CameraSettings RoomCamera(unsigned int imageWidth, unsigned int imageHeight, unsigned int samples);
+
+    // Procedural lat-long map of a small bright sun in a dim blue sky, for scenes lit by the environment alone
+    std::shared_ptr<const EnvironmentMap> SunSkyEnvironment(unsigned int width = 512, unsigned int height = 256);
+
+    // The book camera lit by SunSkyEnvironment
+    CameraSettings SunSkyCamera(unsigned int imageWidth, unsigned int imageHeight, unsigned int samples);
+}
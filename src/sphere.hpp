@@ -47,6 +47,12 @@ namespace RT
             return true;
         }
 
+        virtual AABB BoundingBox() const override
+        {
+            const Vec3 r{m_Radius};
+            return AABB{m_Center - r, m_Center + r};
+        }
+
     private:
         Point3 m_Center;
         float m_Radius;
@@ -14,6 +14,11 @@ namespace RT
                 std::chrono::steady_clock::now() - m_Start).count();
         }
 
+        double PeekSeconds() const
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+        }
+
     private:
         std::chrono::steady_clock::time_point m_Start;
     };
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <utility>
+#include "triangle_mesh.hpp"
+
+namespace RT
+{
+    TriangleMesh::TriangleMesh(std::vector<Point3> vertices, std::vector<std::uint32_t> indices, std::unique_ptr<Material> material)
+        : m_Vertices(std::move(vertices)), m_Indices(std::move(indices)), m_Material(std::move(material))
+    {
+        // Drop a trailing partial triangle and any triangle indexing past the vertex buffer
+        std::size_t triangleCount = 0;
+
+        for (std::size_t t = 0; t < m_Indices.size() / 3; ++t) {
+            const std::uint32_t* triangle = &m_Indices[3 * t];
+
+            if (triangle[0] < m_Vertices.size() && triangle[1] < m_Vertices.size() && triangle[2] < m_Vertices.size()) {
+                std::copy(triangle, triangle + 3, &m_Indices[3 * triangleCount]);
+                ++triangleCount;
+            }
+        }
+
+        m_Indices.resize(triangleCount * 3);
+
+        std::vector<AABB> bounds(triangleCount);
+
+        for (std::size_t t = 0; t < triangleCount; ++t) {
+            bounds[t].Grow(m_Vertices[m_Indices[3 * t + 0]]);
+            bounds[t].Grow(m_Vertices[m_Indices[3 * t + 1]]);
+            bounds[t].Grow(m_Vertices[m_Indices[3 * t + 2]]);
+        }
+
+        const std::vector<std::uint32_t> order = m_Tree.Build(bounds);
+        bounds = {};
+
+        std::vector<std::uint32_t> ordered(m_Indices.size());
+
+        for (std::size_t t = 0; t < triangleCount; ++t) {
+            const std::uint32_t source = order[t];
+            ordered[3 * t + 0] = m_Indices[3 * source + 0];
+            ordered[3 * t + 1] = m_Indices[3 * source + 1];
+            ordered[3 * t + 2] = m_Indices[3 * source + 2];
+        }
+
+        m_Indices = std::move(ordered);
+    }
+
+    TriangleMesh::ShearedRay TriangleMesh::Shear(const Ray& ray)
+    {
+        const Vec3& d = ray.direction();
+        ShearedRay sheared;
+
+        // Shear along the dominant axis, swapping x and y keeps the winding when it points backwards
+        sheared.kz = 0;
+
+        if (std::abs(d.y) > std::abs(d[sheared.kz])) { sheared.kz = 1; }
+        if (std::abs(d.z) > std::abs(d[sheared.kz])) { sheared.kz = 2; }
+
+        sheared.kx = (sheared.kz + 1) % 3;
+        sheared.ky = (sheared.kx + 1) % 3;
+
+        if (d[sheared.kz] < 0.0f) {
+            std::swap(sheared.kx, sheared.ky);
+        }
+
+        sheared.sx = d[sheared.kx] / d[sheared.kz];
+        sheared.sy = d[sheared.ky] / d[sheared.kz];
+        sheared.sz = 1.0f / d[sheared.kz];
+
+        return sheared;
+    }
+
+    // Woop, Benthin and Wald, "Watertight Ray/Triangle Intersection". Edge functions are evaluated
+    // in a ray aligned frame, so rays through shared edges and vertices can never slip between triangles.
+    bool TriangleMesh::IntersectTriangle(std::uint32_t triangle, const Ray& ray, const ShearedRay& sheared, float tMin, float* tMax) const
+    {
+        const Point3& o = ray.origin();
+        const Vec3 a = m_Vertices[m_Indices[3 * triangle + 0]] - o;
+        const Vec3 b = m_Vertices[m_Indices[3 * triangle + 1]] - o;
+        const Vec3 c = m_Vertices[m_Indices[3 * triangle + 2]] - o;
+
+        const float ax = a[sheared.kx] - sheared.sx * a[sheared.kz];
+        const float ay = a[sheared.ky] - sheared.sy * a[sheared.kz];
+        const float bx = b[sheared.kx] - sheared.sx * b[sheared.kz];
+        const float by = b[sheared.ky] - sheared.sy * b[sheared.kz];
+        const float cx = c[sheared.kx] - sheared.sx * c[sheared.kz];
+        const float cy = c[sheared.ky] - sheared.sy * c[sheared.kz];
+
+        float u = cx * by - cy * bx;
+        float v = ax * cy - ay * cx;
+        float w = bx * ay - by * ax;
+
+        // An edge function of exactly zero may be a rounding artifact, settle it in double precision
+        if (u == 0.0f || v == 0.0f || w == 0.0f) {
+            u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+            v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+            w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+        }
+
+        if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) {
+            return false;
+        }
+
+        const float det = u + v + w;
+
+        if (det == 0.0f) {
+            return false;
+        }
+
+        const float az = sheared.sz * a[sheared.kz];
+        const float bz = sheared.sz * b[sheared.kz];
+        const float cz = sheared.sz * c[sheared.kz];
+
+        const float t = (u * az + v * bz + w * cz) / det;
+
+        if (!(t > tMin && t < *tMax)) {
+            return false;
+        }
+
+        *tMax = t;
+        return true;
+    }
+
+    void TriangleMesh::FillHitInfo(std::uint32_t triangle, const Ray& ray, float t, HitInfo* hitInfo) const
+    {
+        const Point3& p0 = m_Vertices[m_Indices[3 * triangle + 0]];
+        const Point3& p1 = m_Vertices[m_Indices[3 * triangle + 1]];
+        const Point3& p2 = m_Vertices[m_Indices[3 * triangle + 2]];
+
+        hitInfo->t = t;
+        hitInfo->point = ray.at(t);
+        hitInfo->SetFaceNormal(ray, Normalize(Cross(p1 - p0, p2 - p0)));
+        hitInfo->material = m_Material.get();
+    }
+
+    bool TriangleMesh::Hit(const Ray& ray, const Interval& rayInterval, HitInfo* hitInfo) const
+    {
+        const ShearedRay sheared = Shear(ray);
+        std::uint32_t closest = 0;
+        float closestT = 0.0f;
+
+        const bool hit = m_Tree.Traverse(ray, rayInterval, [&](std::uint32_t triangle, float tMin, float* tMax) {
+            if (!IntersectTriangle(triangle, ray, sheared, tMin, tMax)) {
+                return false;
+            }
+
+            closest = triangle;
+            closestT = *tMax;
+            return true;
+        });
+
+        if (hit) {
+            FillHitInfo(closest, ray, closestT, hitInfo);
+        }
+
+        return hit;
+    }
+
+    std::uint64_t TriangleMesh::HitPacket(const RayPacket& packet, std::uint64_t mask, float tMin, float* tMax,
+        HitInfo* hitInfos) const
+    {
+        // A lone ray gains nothing from the packet bookkeeping
+        if (std::has_single_bit(mask)) {
+            return Hittable::HitPacket(packet, mask, tMin, tMax, hitInfos);
+        }
+
+        ShearedRay sheared[RayPacket::MaxSize];
+        std::uint32_t closest[RayPacket::MaxSize];
+
+        for (std::uint64_t active = mask; active != 0; active &= active - 1) {
+            const unsigned int r = static_cast<unsigned int>(std::countr_zero(active));
+            sheared[r] = Shear(packet.rays[r]);
+        }
+
+        const std::uint64_t hits = m_Tree.TraversePacket(packet, mask, tMin, tMax, [&](std::uint32_t triangle, std::uint64_t leafMask, float leafTMin, float* leafTMax) {
+            std::uint64_t triangleHits = 0;
+
+            for (; leafMask != 0; leafMask &= leafMask - 1) {
+                const unsigned int r = static_cast<unsigned int>(std::countr_zero(leafMask));
+
+                if (IntersectTriangle(triangle, packet.rays[r], sheared[r], leafTMin, &leafTMax[r])) {
+                    closest[r] = triangle;
+                    triangleHits |= std::uint64_t{1} << r;
+                }
+            }
+
+            return triangleHits;
+        });
+
+        for (std::uint64_t active = hits; active != 0; active &= active - 1) {
+            const unsigned int r = static_cast<unsigned int>(std::countr_zero(active));
+            FillHitInfo(closest[r], packet.rays[r], tMax[r], &hitInfos[r]);
+        }
+
+        return hits;
+    }
+}
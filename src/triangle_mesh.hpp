@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "hittable.hpp"
+#include "material.hpp"
+#include "bvh.hpp"
+
+namespace RT
+{
+    // Indexed triangle mesh with a single material, flat shaded. Triangles live in their own
+    // QBVH, so the whole mesh is one primitive of the scene BVH.
+    class TriangleMesh : public Hittable
+    {
+    public:
+        // indices holds three vertex indices per triangle, both buffers are taken over. Triangles with an
+        // index past the end of vertices are dropped, see TriangleCount for what is left. At most
+        // QBVH::MaxPrimitives triangles.
+        TriangleMesh(std::vector<Point3> vertices, std::vector<std::uint32_t> indices, std::unique_ptr<Material> material);
+
+        virtual bool Hit(const Ray& ray, const Interval& rayInterval, HitInfo* hitInfo) const override;
+        virtual std::uint64_t HitPacket(const RayPacket& packet, std::uint64_t mask, float tMin, float* tMax,
+            HitInfo* hitInfos) const override;
+        virtual AABB BoundingBox() const override { return m_Tree.Bounds(); }
+        virtual std::size_t PrimitiveCount() const override { return TriangleCount(); }
+        virtual std::size_t AccelerationMemoryUsage() const override { return m_Tree.MemoryUsage(); }
+
+        std::size_t VertexCount() const { return m_Vertices.size(); }
+        std::size_t TriangleCount() const { return m_Indices.size() / 3; }
+
+        // Vertex and index buffers plus the triangle BVH
+        std::size_t MemoryUsage() const
+        {
+            return m_Vertices.size() * sizeof(Point3) + m_Indices.size() * sizeof(std::uint32_t) + m_Tree.MemoryUsage();
+        }
+
+    private:
+        // Per ray setup of the watertight test, the ray is sheared so it runs along +z
+        struct ShearedRay
+        {
+            int kx;
+            int ky;
+            int kz;
+            float sx;
+            float sy;
+            float sz;
+        };
+
+        static ShearedRay Shear(const Ray& ray);
+
+        bool IntersectTriangle(std::uint32_t triangle, const Ray& ray, const ShearedRay& sheared, float tMin, float* tMax) const;
+        void FillHitInfo(std::uint32_t triangle, const Ray& ray, float t, HitInfo* hitInfo) const;
+
+    private:
+        std::vector<Point3> m_Vertices;
+        std::vector<std::uint32_t> m_Indices;
+        std::unique_ptr<Material> m_Material;
+        QBVH m_Tree;
+    };
+}
@@ -0,0 +1,205 @@
+// Framebuffer pixel format tests.
+//
+// Finished tiles are packed to 6 byte fp16 or 4 byte RGB9E5 pixels. These tests write known means
+// through the accumulators of an image whose edge tiles are partial, finish it and check every
+// decoded pixel against the error bound of its format: zero, denormal, very large, negative and
+// channel imbalanced values, and pixels that never took a sample.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "framebuffer.hpp"
+
+namespace
+{
+    using namespace RT;
+
+    constexpr unsigned int s_Width = 21;
+    constexpr unsigned int s_Height = 13;
+
+    // Largest finite values of the formats
+    constexpr float s_HalfMax = 65504.0f;
+    constexpr float s_RGB9E5Max = 65408.0f;
+
+    // Smallest normal half, below it halves step in 2^-24
+    const float s_HalfMinNormal = std::ldexp(1.0f, -14);
+
+    const Color s_Values[] = {
+        Color{0.0f, 0.0f, 0.0f},
+        Color{0.5f, 0.25f, 1.0f},
+        Color{0.18f, 0.33f, 0.71f},
+        Color{1.0e-3f, 2.5e-2f, 7.0f},
+        // fp16 denormals and values below the smallest denormal
+        Color{3.0e-5f, 1.0e-6f, 1.0e-8f},
+        Color{std::ldexp(1.0f, -24), std::ldexp(1.5f, -20), std::ldexp(1.0f, -15)},
+        // Very large, at and past the largest finite value
+        Color{1000.0f, 30000.0f, 65504.0f},
+        Color{70000.0f, 1.0e6f, 1.0e30f},
+        // Channel imbalance, the shared exponent of RGB9E5 follows the largest channel
+        Color{5000.0f, 0.01f, 1.0f},
+        Color{1.0e-4f, 1.0e-4f, 100.0f},
+        // Rounds up into the next exponent
+        Color{0.9995f, 0.5f, 2.0e-3f},
+        // Negative radiance decodes as itself in fp16 and clamps to zero in RGB9E5
+        Color{-0.5f, 0.5f, -2.0e-6f},
+    };
+
+    constexpr std::size_t s_ValueCount = sizeof(s_Values) / sizeof(s_Values[0]);
+
+    // Every third pixel takes no samples, the rest take their value twice
+    bool Sampled(unsigned int i, unsigned int j)
+    {
+        return (i + j * s_Width) % 3 != 2;
+    }
+
+    const Color& Expected(unsigned int i, unsigned int j)
+    {
+        return s_Values[(i + j * s_Width) % s_ValueCount];
+    }
+
+    bool WithinHalf(float expected, float decoded)
+    {
+        const float clamped = std::clamp(expected, -s_HalfMax, s_HalfMax);
+        const float magnitude = std::abs(clamped);
+
+        // Round to nearest: half an ulp, 2^-11 relative for normals and 2^-25 absolute below
+        const float bound = (magnitude >= s_HalfMinNormal) ? magnitude * std::ldexp(1.0f, -11) : std::ldexp(1.0f, -25);
+
+        return std::abs(decoded - clamped) <= bound;
+    }
+
+    bool WithinRGB9E5(const Color& expected, const Color& decoded)
+    {
+        Color clamped;
+
+        for (int c = 0; c < 3; ++c) {
+            clamped[c] = std::clamp(expected[c], 0.0f, s_RGB9E5Max);
+        }
+
+        // Nine mantissa bits under the largest channel's exponent: every channel is off by at most
+        // 2^-8 of the largest one (a rounding carry doubles the step), or half the smallest step
+        const float maxChannel = std::max({clamped.x, clamped.y, clamped.z});
+        const float bound = std::max(maxChannel * std::ldexp(1.0f, -8), std::ldexp(1.0f, -25));
+
+        for (int c = 0; c < 3; ++c) {
+            if (!(std::abs(decoded[c] - clamped[c]) <= bound)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool CheckFormat(PixelFormat format, const char* name)
+    {
+        Framebuffer image{s_Width, s_Height, format};
+
+        for (unsigned int j = 0; j < s_Height; ++j) {
+            for (unsigned int i = 0; i < s_Width; ++i) {
+                if (!Sampled(i, j)) {
+                    continue;
+                }
+
+                // Two samples, their fp32 mean is exactly the value
+                Framebuffer::AccumulatorTile& tile = image.Accumulator(i / Framebuffer::TileSize, j / Framebuffer::TileSize);
+                tile.Add(i % Framebuffer::TileSize, j % Framebuffer::TileSize, Expected(i, j));
+                tile.Add(i % Framebuffer::TileSize, j % Framebuffer::TileSize, Expected(i, j));
+            }
+        }
+
+        image.Finish();
+
+        unsigned int failures = 0;
+
+        for (unsigned int j = 0; j < s_Height; ++j) {
+            for (unsigned int i = 0; i < s_Width; ++i) {
+                const Color decoded = image.Pixel(i, j);
+                const Color expected = Sampled(i, j) ? Expected(i, j) : Color{0.0f};
+                bool within = true;
+
+                switch (format) {
+                case PixelFormat::Half:
+                    within = WithinHalf(expected.x, decoded.x) && WithinHalf(expected.y, decoded.y) && WithinHalf(expected.z, decoded.z);
+                    break;
+
+                case PixelFormat::RGB9E5:
+                    within = WithinRGB9E5(expected, decoded);
+                    break;
+
+                case PixelFormat::Float32:
+                default:
+                    within = decoded.x == expected.x && decoded.y == expected.y && decoded.z == expected.z;
+                    break;
+                }
+
+                if (!within) {
+                    std::cout << "FAILED: " << name << " pixel (" << i << ", " << j << ") expected (" << expected.x << ", "
+                        << expected.y << ", " << expected.z << ") decoded (" << decoded.x << ", " << decoded.y << ", "
+                        << decoded.z << ")" << std::endl;
+                    ++failures;
+                }
+            }
+        }
+
+        // ResolveRow reads the same packed pixels
+        std::vector<Color> resolved;
+        image.Resolve(&resolved);
+
+        for (unsigned int j = 0; j < s_Height; ++j) {
+            for (unsigned int i = 0; i < s_Width; ++i) {
+                const Color& pixel = resolved[static_cast<std::size_t>(j) * s_Width + i];
+                const Color decoded = image.Pixel(i, j);
+
+                if (pixel.x != decoded.x || pixel.y != decoded.y || pixel.z != decoded.z) {
+                    std::cout << "FAILED: " << name << " resolved pixel (" << i << ", " << j << ") differs from Pixel" << std::endl;
+                    ++failures;
+                }
+            }
+        }
+
+        return failures == 0;
+    }
+
+    // Finished fp16 and RGB9E5 tiles drop their accumulators and keep 6 and 4 bytes per pixel
+    bool CheckMemory()
+    {
+        const unsigned int tiles = ((s_Width + Framebuffer::TileSize - 1) / Framebuffer::TileSize) *
+            ((s_Height + Framebuffer::TileSize - 1) / Framebuffer::TileSize);
+
+        Framebuffer half{s_Width, s_Height, PixelFormat::Half};
+        Framebuffer shared{s_Width, s_Height, PixelFormat::RGB9E5};
+
+        for (Framebuffer* image : {&half, &shared}) {
+            for (unsigned int tileY = 0; tileY < image->TilesY(); ++tileY) {
+                for (unsigned int tileX = 0; tileX < image->TilesX(); ++tileX) {
+                    image->Accumulator(tileX, tileY).Add(0, 0, Color{1.0f});
+                }
+            }
+
+            image->Finish();
+        }
+
+        const std::size_t difference = half.MemoryUsage() - shared.MemoryUsage();
+
+        if (difference != static_cast<std::size_t>(tiles) * Framebuffer::TilePixels * 2) {
+            std::cout << "FAILED: fp16 pixels take " << difference << " more bytes than RGB9E5 over " << tiles << " tiles" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+}
+
+int main()
+{
+    bool passed = true;
+
+    passed = CheckFormat(PixelFormat::Float32, "fp32") && passed;
+    passed = CheckFormat(PixelFormat::Half, "fp16") && passed;
+    passed = CheckFormat(PixelFormat::RGB9E5, "rgb9e5") && passed;
+    passed = CheckMemory() && passed;
+
+    std::cout << (passed ? "All framebuffer tests passed" : "Framebuffer tests FAILED") << std::endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
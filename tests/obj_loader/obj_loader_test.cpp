@@ -0,0 +1,213 @@
+// OBJ loader tests.
+//
+// The loader cuts files into chunks at line boundaries and parses them in parallel, but only for
+// files over 1 MiB on machines with more than one core. These tests force the chunk count on small
+// files instead, so the chunk merging and the resolution of relative indices across chunks run
+// everywhere, and check that every chunking gives the same mesh as a single chunk.
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "obj_loader.hpp"
+
+namespace
+{
+    using namespace RT;
+
+    struct Mesh
+    {
+        std::vector<Point3> vertices;
+        std::vector<std::uint32_t> indices;
+    };
+
+    // Every face form the loader accepts: plain, v/vt, v//vn and v/vt/vn indices, negative indices
+    // counting back from the last vertex (some reaching vertices many lines up), polygons, CRLF line
+    // ends, comments, other statements and a last line without a line end.
+    const char s_ObjText[] =
+        "# Test mesh\r\n"
+        "mtllib test.mtl\r\n"
+        "o first\r\n"
+        "v 0 0 0\r\n"
+        "v 1 0 0\r\n"
+        "v 1 1 0\r\n"
+        "v 0 1 0\r\n"
+        "vt 0 0\r\n"
+        "vn 0 0 1\r\n"
+        "f 1 2 3\r\n"
+        "f 1/1 3/1 4/1\r\n"
+        "\r\n"
+        "o second\n"
+        "  v  +2.5 -0.5 1e-1\n"
+        "v 3.5 -0.5 0.1\n"
+        "v 3.5 0.5 0.1 1.0\n"
+        "v 2.5 0.5 0.1\n"
+        "usemtl red\n"
+        "f -4 -3 -2 -1\n"
+        "f 5//1 7//1 8//1 # trailing comment\n"
+        "v 0 0 2\n"
+        "v 1 0 2\n"
+        "v 1 1 2\n"
+        "v 0 1 2\n"
+        "v 0.5 0.5 3\n"
+        "g top\n"
+        "s off\n"
+        "f -5/1/1 -4/1/1 -1/1/1\n"
+        "f -4/1/1 -3/1/1 -1/1/1\n"
+        "f -3/1/1 -2/1/1 -1/1/1\n"
+        "f -2/1/1 -5/1/1 -1/1/1\n"
+        "f 1 2 10 9\n"
+        "f -13 -12 -11";
+
+    // Zero based, polygons fanned from their first vertex
+    const std::uint32_t s_ExpectedIndices[] = {
+        0, 1, 2,
+        0, 2, 3,
+        4, 5, 6,
+        4, 6, 7,
+        4, 6, 7,
+        8, 9, 12,
+        9, 10, 12,
+        10, 11, 12,
+        11, 8, 12,
+        0, 1, 9,
+        0, 9, 8,
+        0, 1, 2,
+    };
+
+    const float s_ExpectedX[] = {0.0f, 1.0f, 1.0f, 0.0f, 2.5f, 3.5f, 3.5f, 2.5f, 0.0f, 1.0f, 1.0f, 0.0f, 0.5f};
+
+    bool WriteFile(const std::filesystem::path& path, const std::string& text)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+
+        return static_cast<bool>(file);
+    }
+
+    bool SameMesh(const Mesh& a, const Mesh& b)
+    {
+        if (a.vertices.size() != b.vertices.size() || a.indices != b.indices) {
+            return false;
+        }
+
+        for (std::size_t v = 0; v < a.vertices.size(); ++v) {
+            for (int axis = 0; axis < 3; ++axis) {
+                if (a.vertices[v][axis] != b.vertices[v][axis]) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool CheckExpected(const Mesh& mesh)
+    {
+        const std::vector<std::uint32_t> expectedIndices(std::begin(s_ExpectedIndices), std::end(s_ExpectedIndices));
+
+        if (mesh.indices != expectedIndices || mesh.vertices.size() != std::size(s_ExpectedX)) {
+            return false;
+        }
+
+        for (std::size_t v = 0; v < mesh.vertices.size(); ++v) {
+            if (mesh.vertices[v].x != s_ExpectedX[v]) {
+                return false;
+            }
+        }
+
+        return mesh.vertices[4].y == -0.5f && mesh.vertices[4].z == 0.1f && mesh.vertices[12].z == 3.0f;
+    }
+
+    // Text that must not load, with any chunking
+    struct InvalidCase
+    {
+        const char* name;
+        const char* text;
+    };
+
+    const InvalidCase s_InvalidCases[] = {
+        {"empty file", ""},
+        {"no faces", "v 0 0 0\nv 1 0 0\nv 0 1 0\n"},
+        {"index past the vertices", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n"},
+        {"relative index before the first vertex", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -1 -2 -4\n"},
+        {"zero index", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n"},
+        {"two vertex face", "v 0 0 0\nv 1 0 0\nf 1 2\n"},
+        {"malformed vertex", "v 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n"},
+    };
+}
+
+int main()
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::filesystem::path path = directory / "raytracer_obj_loader_test.obj";
+    const std::string filename = path.string();
+
+    bool passed = true;
+
+    // Far more chunks than the file has lines leaves most chunks empty
+    constexpr std::size_t maxChunks = 48;
+
+    if (!WriteFile(path, s_ObjText)) {
+        std::cout << "FAILED: could not write " << filename << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Mesh single;
+
+    if (!LoadOBJ(filename.c_str(), &single.vertices, &single.indices, 1)) {
+        std::cout << "FAILED: single chunk load" << std::endl;
+        passed = false;
+    }
+    else if (!CheckExpected(single)) {
+        std::cout << "FAILED: single chunk load does not match the expected mesh" << std::endl;
+        passed = false;
+    }
+
+    for (std::size_t chunks = 2; chunks <= maxChunks; ++chunks) {
+        Mesh chunked;
+
+        if (!LoadOBJ(filename.c_str(), &chunked.vertices, &chunked.indices, chunks) || !SameMesh(single, chunked)) {
+            std::cout << "FAILED: " << chunks << " chunks differ from a single chunk" << std::endl;
+            passed = false;
+        }
+    }
+
+    Mesh automatic;
+
+    if (!LoadOBJ(filename.c_str(), &automatic.vertices, &automatic.indices) || !SameMesh(single, automatic)) {
+        std::cout << "FAILED: default chunking differs from a single chunk" << std::endl;
+        passed = false;
+    }
+
+    for (const InvalidCase& invalid : s_InvalidCases) {
+        if (!WriteFile(path, invalid.text)) {
+            std::cout << "FAILED: could not write " << filename << std::endl;
+            passed = false;
+            continue;
+        }
+
+        for (std::size_t chunks = 1; chunks <= 8; ++chunks) {
+            Mesh mesh;
+
+            if (LoadOBJ(filename.c_str(), &mesh.vertices, &mesh.indices, chunks)) {
+                std::cout << "FAILED: " << invalid.name << " loaded with " << chunks << " chunks" << std::endl;
+                passed = false;
+            }
+        }
+    }
+
+    Mesh missing;
+
+    if (LoadOBJ((directory / "raytracer_obj_loader_test_missing.obj").string().c_str(), &missing.vertices, &missing.indices)) {
+        std::cout << "FAILED: missing file loaded" << std::endl;
+        passed = false;
+    }
+
+    std::filesystem::remove(path);
+
+    std::cout << (passed ? "All OBJ loader tests passed" : "OBJ loader tests FAILED") << std::endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,430 @@
+// Image quality versus time regression harness.
+//
+// Renders fixed seed scenes at several sample, ray and time budgets, compares each result against a
+// stored high sample count reference and writes one convergence curve per scene. Sample and ray
+// budget results are deterministic for a given build, so they are checked against the stored
+// baseline curve on every run. Ray budgets stand in for time on any machine: a change that makes
+// rays cheaper but needs more of them for the same image fails there. Time budget results depend
+// on the machine and are only checked with --check-time, against a baseline recorded on the same machine.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "timer.hpp"
+#include "bvh.hpp"
+#include "camera.hpp"
+#include "scenes.hpp"
+#include "pfm.hpp"
+
+namespace
+{
+    using namespace RT;
+
+    constexpr std::uint32_t s_SceneSeed = 42;
+    constexpr std::uint32_t s_RenderSeed = 1337;
+
+    // Allowed slack against the baseline curve
+    constexpr double s_ErrorTolerance = 0.10;
+    constexpr double s_SSIMTolerance = 0.01;
+    constexpr double s_TimeTolerance = 0.25;
+
+    struct QualityScene
+    {
+        const char* name;
+        void (*build)(HittableList* world);
+        CameraSettings (*camera)(unsigned int imageWidth, unsigned int imageHeight, unsigned int samples);
+        unsigned int width;
+        unsigned int height;
+        unsigned int referenceSamples;
+    };
+
+    const QualityScene s_Scenes[] = {
+        {"book", BookScene, BookCamera, 160, 90, 4096},
+        {"sunsky", BookScene, SunSkyCamera, 160, 90, 4096},
+    };
+
+    const unsigned int s_SampleBudgets[] = {1, 4, 16, 64};
+
+    // Rays traced per pixel, primary and secondary
+    const unsigned int s_RayBudgets[] = {8, 32, 128};
+    const float s_TimeBudgets[] = {0.25f, 1.0f};
+
+    struct Measurement
+    {
+        std::string budget;
+        unsigned int samples = 0;
+        std::uint64_t rays = 0;
+        double seconds = 0.0;
+        double rmse = 0.0;
+        double relMSE = 0.0;
+        double ssim = 0.0;
+    };
+
+    float DisplayLuminance(const Color& c)
+    {
+        auto display = [](float v) { return std::pow(std::clamp(v, 0.0f, 1.0f), 1.0f / 2.2f); };
+        return 0.2126f * display(c.x) + 0.7152f * display(c.y) + 0.0722f * display(c.z);
+    }
+
+    double RMSE(const std::vector<Color>& image, const std::vector<Color>& reference)
+    {
+        double sum = 0.0;
+
+        for (std::size_t p = 0; p < image.size(); ++p) {
+            for (int c = 0; c < 3; ++c) {
+                const double d = image[p][c] - reference[p][c];
+                sum += d * d;
+            }
+        }
+
+        return std::sqrt(sum / (3.0 * image.size()));
+    }
+
+    double RelMSE(const std::vector<Color>& image, const std::vector<Color>& reference)
+    {
+        double sum = 0.0;
+
+        for (std::size_t p = 0; p < image.size(); ++p) {
+            for (int c = 0; c < 3; ++c) {
+                const double d = image[p][c] - reference[p][c];
+                sum += (d * d) / (reference[p][c] * reference[p][c] + 1.0E-2);
+            }
+        }
+
+        return sum / (3.0 * image.size());
+    }
+
+    // Mean SSIM of display luminance over 8x8 windows with a stride of 4
+    double SSIM(const std::vector<Color>& image, const std::vector<Color>& reference, unsigned int width, unsigned int height)
+    {
+        constexpr unsigned int window = 8;
+        constexpr unsigned int stride = 4;
+        constexpr double c1 = 0.01 * 0.01;
+        constexpr double c2 = 0.03 * 0.03;
+
+        double sum = 0.0;
+        unsigned int windows = 0;
+
+        for (unsigned int y0 = 0; y0 + window <= height; y0 += stride) {
+            for (unsigned int x0 = 0; x0 + window <= width; x0 += stride) {
+                double meanA = 0.0, meanB = 0.0, varA = 0.0, varB = 0.0, covariance = 0.0;
+
+                for (unsigned int y = y0; y < y0 + window; ++y) {
+                    for (unsigned int x = x0; x < x0 + window; ++x) {
+                        meanA += DisplayLuminance(image[y * width + x]);
+                        meanB += DisplayLuminance(reference[y * width + x]);
+                    }
+                }
+
+                meanA /= window * window;
+                meanB /= window * window;
+
+                for (unsigned int y = y0; y < y0 + window; ++y) {
+                    for (unsigned int x = x0; x < x0 + window; ++x) {
+                        const double a = DisplayLuminance(image[y * width + x]) - meanA;
+                        const double b = DisplayLuminance(reference[y * width + x]) - meanB;
+
+                        varA += a * a;
+                        varB += b * b;
+                        covariance += a * b;
+                    }
+                }
+
+                varA /= window * window - 1;
+                varB /= window * window - 1;
+                covariance /= window * window - 1;
+
+                sum += ((2.0 * meanA * meanB + c1) * (2.0 * covariance + c2)) /
+                    ((meanA * meanA + meanB * meanB + c1) * (varA + varB + c2));
+                ++windows;
+            }
+        }
+
+        return windows > 0 ? sum / windows : 1.0;
+    }
+
+    std::vector<Color> RenderScene(const QualityScene& scene, const Hittable& world,
+        unsigned int samples, float timeBudget, std::uint64_t rayBudget, Measurement* measurement)
+    {
+        CameraSettings settings = scene.camera(scene.width, scene.height, samples);
+        settings.timeBudget = timeBudget;
+        settings.rayBudget = rayBudget;
+
+        SeedRandom(s_RenderSeed);
+
+        Camera camera{settings};
+        std::vector<Color> pixels;
+
+        Timer timer{};
+        camera.Render(world, &pixels);
+
+        if (measurement) {
+            measurement->seconds = timer.PeekSeconds();
+            measurement->samples = camera.SamplesRendered();
+            measurement->rays = camera.RayCount();
+        }
+
+        return pixels;
+    }
+
+    void Measure(const std::vector<Color>& image, const std::vector<Color>& reference, const QualityScene& scene, Measurement* measurement)
+    {
+        measurement->rmse = RMSE(image, reference);
+        measurement->relMSE = RelMSE(image, reference);
+        measurement->ssim = SSIM(image, reference, scene.width, scene.height);
+    }
+
+    bool WriteCurve(const std::filesystem::path& path, const std::vector<Measurement>& curve)
+    {
+        std::ofstream file{path};
+
+        if (!file.is_open()) {
+            return false;
+        }
+
+        file << "budget,spp,rays,seconds,rmse,relmse,ssim\n";
+
+        for (const Measurement& m : curve) {
+            file << m.budget << "," << m.samples << "," << m.rays << "," << m.seconds << "," << m.rmse << "," << m.relMSE << "," << m.ssim << "\n";
+        }
+
+        return file.good();
+    }
+
+    bool ReadCurve(const std::filesystem::path& path, std::map<std::string, Measurement>* curve)
+    {
+        std::ifstream file{path};
+        std::string line;
+
+        if (!file.is_open() || !std::getline(file, line)) {
+            return false;
+        }
+
+        while (std::getline(file, line)) {
+            std::istringstream fields{line};
+            std::string field;
+            std::vector<std::string> values;
+
+            while (std::getline(fields, field, ',')) {
+                values.push_back(field);
+            }
+
+            if (values.size() != 7) {
+                return false;
+            }
+
+            Measurement m;
+            m.budget = values[0];
+            m.samples = static_cast<unsigned int>(std::stoul(values[1]));
+            m.rays = std::stoull(values[2]);
+            m.seconds = std::stod(values[3]);
+            m.rmse = std::stod(values[4]);
+            m.relMSE = std::stod(values[5]);
+            m.ssim = std::stod(values[6]);
+
+            (*curve)[m.budget] = m;
+        }
+
+        return true;
+    }
+
+    bool RunScene(const QualityScene& scene, const std::filesystem::path& references, const std::filesystem::path& output,
+        bool update, bool checkTime)
+    {
+        std::cout << "Scene '" << scene.name << "' [" << scene.width << "x" << scene.height << "]" << std::endl;
+
+        SeedRandom(s_SceneSeed);
+
+        HittableList list;
+        scene.build(&list);
+        const BVH world{std::move(list)};
+
+        const std::filesystem::path referencePath = references / (std::string{scene.name} + ".pfm");
+        const std::filesystem::path baselinePath = references / (std::string{scene.name} + "_baseline.csv");
+
+        std::vector<Color> reference;
+
+        if (update) {
+            std::cout << "  Rendering reference at " << scene.referenceSamples << " samples..." << std::endl;
+            reference = RenderScene(scene, world, scene.referenceSamples, 0.0f, 0, nullptr);
+
+            if (!WritePFM(referencePath.string().c_str(), scene.width, scene.height, reinterpret_cast<const float*>(reference.data()))) {
+                std::cerr << "  Failed to write reference: " << referencePath << std::endl;
+                return false;
+            }
+        }
+        else {
+            unsigned int width = 0;
+            unsigned int height = 0;
+            std::vector<float> values;
+
+            if (!ReadPFM(referencePath.string().c_str(), &width, &height, &values) || width != scene.width || height != scene.height) {
+                std::cerr << "  Missing or mismatched reference: " << referencePath << std::endl;
+                return false;
+            }
+
+            reference.resize(width * height);
+
+            for (std::size_t p = 0; p < reference.size(); ++p) {
+                reference[p] = Color{values[p * 3 + 0], values[p * 3 + 1], values[p * 3 + 2]};
+            }
+        }
+
+        std::vector<Measurement> curve;
+
+        for (unsigned int samples : s_SampleBudgets) {
+            Measurement m;
+            m.budget = "spp:" + std::to_string(samples);
+            Measure(RenderScene(scene, world, samples, 0.0f, 0, &m), reference, scene, &m);
+            curve.push_back(m);
+        }
+
+        const std::uint64_t pixels = static_cast<std::uint64_t>(scene.width) * scene.height;
+
+        for (unsigned int raysPerPixel : s_RayBudgets) {
+            Measurement m;
+            m.budget = "rays:" + std::to_string(raysPerPixel);
+            Measure(RenderScene(scene, world, 1u << 20, 0.0f, raysPerPixel * pixels, &m), reference, scene, &m);
+            curve.push_back(m);
+        }
+
+        for (float seconds : s_TimeBudgets) {
+            // Effectively unbounded sample count, the deadline ends the render
+            Measurement m;
+            std::ostringstream budget;
+            budget << "sec:" << seconds;
+            m.budget = budget.str();
+            Measure(RenderScene(scene, world, 1u << 20, seconds, 0, &m), reference, scene, &m);
+            curve.push_back(m);
+        }
+
+        for (const Measurement& m : curve) {
+            std::cout << "  " << m.budget << ": " << m.samples << " spp, " << m.rays << " rays, " << m.seconds << " sec, RMSE " << m.rmse
+                << ", relMSE " << m.relMSE << ", SSIM " << m.ssim << std::endl;
+        }
+
+        const std::filesystem::path curvePath = output / (std::string{scene.name} + "_curve.csv");
+
+        if (!WriteCurve(curvePath, curve)) {
+            std::cerr << "  Failed to write convergence curve: " << curvePath << std::endl;
+            return false;
+        }
+
+        if (update) {
+            return WriteCurve(baselinePath, curve);
+        }
+
+        std::map<std::string, Measurement> baseline;
+
+        if (!ReadCurve(baselinePath, &baseline)) {
+            std::cerr << "  Missing or malformed baseline: " << baselinePath << std::endl;
+            return false;
+        }
+
+        bool passed = true;
+
+        for (const Measurement& m : curve) {
+            const auto found = baseline.find(m.budget);
+
+            if (found == baseline.end()) {
+                continue;
+            }
+
+            const Measurement& base = found->second;
+            const bool timed = m.budget.starts_with("sec:");
+
+            if (timed && !checkTime) {
+                continue;
+            }
+
+            const double tolerance = timed ? s_TimeTolerance : s_ErrorTolerance;
+
+            const bool worse = m.rmse > base.rmse * (1.0 + tolerance) ||
+                m.relMSE > base.relMSE * (1.0 + tolerance) ||
+                m.ssim < base.ssim - s_SSIMTolerance;
+
+            if (worse) {
+                std::cerr << "  Regression at " << m.budget << ": RMSE " << m.rmse << " (baseline " << base.rmse
+                    << "), relMSE " << m.relMSE << " (baseline " << base.relMSE << "), SSIM " << m.ssim
+                    << " (baseline " << base.ssim << ")" << std::endl;
+                passed = false;
+            }
+        }
+
+        return passed;
+    }
+
+    void PrintUsage()
+    {
+        std::cout << "Usage: raytracer_quality --references [dir] [options]\n";
+        std::cout << "Options:\n";
+        std::cout << "  --output [dir]     Where convergence curves are written (default: current directory)\n";
+        std::cout << "  --scene [name]     Only run the named scene\n";
+        std::cout << "  --update           Re-render the references and record the current curves as the baseline\n";
+        std::cout << "  --check-time       Also check time budget results, only meaningful on the baseline's machine" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::filesystem::path references;
+    std::filesystem::path output = ".";
+    std::string sceneFilter;
+    bool update = false;
+    bool checkTime = false;
+
+    for (int arg = 1; arg < argc; ++arg) {
+        const std::string option = argv[arg];
+
+        if (option == "--references" && arg + 1 < argc) {
+            references = argv[++arg];
+        }
+        else if (option == "--output" && arg + 1 < argc) {
+            output = argv[++arg];
+        }
+        else if (option == "--scene" && arg + 1 < argc) {
+            sceneFilter = argv[++arg];
+        }
+        else if (option == "--update") {
+            update = true;
+        }
+        else if (option == "--check-time") {
+            checkTime = true;
+        }
+        else {
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (references.empty()) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(output, error);
+
+    if (update) {
+        std::filesystem::create_directories(references, error);
+    }
+
+    bool passed = true;
+
+    for (const QualityScene& scene : s_Scenes) {
+        if (!sceneFilter.empty() && sceneFilter != scene.name) {
+            continue;
+        }
+
+        passed = RunScene(scene, references, output, update, checkTime) && passed;
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}